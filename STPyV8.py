@@ -4,8 +4,10 @@
 from __future__ import with_statement
 from __future__ import print_function
 
+import os
 import re
 import collections.abc
+import contextlib
 
 import _STPyV8
 
@@ -16,6 +18,7 @@ __all__ = ["ReadOnly",
            "DontDelete",
            "Internal",
            "JSError",
+           "JSTimeoutError",
            "JSObject",
            "JSNull",
            "JSUndefined",
@@ -24,6 +27,8 @@ __all__ = ["ReadOnly",
            "JSClass",
            "JSEngine",
            "JSContext",
+           "JSContextPool",
+           "JSContextScope",
            "JSIsolate",
            "JSStackTrace",
            "JSStackFrame",
@@ -105,6 +110,8 @@ class JSError(Exception):
 
 _STPyV8._JSError._jsclass = JSError
 
+JSTimeoutError = _STPyV8.JSTimeoutError
+
 JSObject    = _STPyV8.JSObject
 JSNull      = _STPyV8.JSNull
 JSUndefined = _STPyV8.JSUndefined
@@ -284,6 +291,8 @@ class JSEngine(_STPyV8.JSEngine):
         del self
 
 
+JSEngine.MemoryPressureLevel = _STPyV8.JSMemoryPressureLevel
+
 JSScript = _STPyV8.JSScript
 JSStackTrace = _STPyV8.JSStackTrace
 JSStackTrace.Options = _STPyV8.JSStackTraceOptions
@@ -301,8 +310,11 @@ class JSIsolate(_STPyV8.JSIsolate):
         del self
 
 
+JSIsolate.MicrotasksPolicy = _STPyV8.JSMicrotasksPolicy
+
+
 class JSContext(_STPyV8.JSContext):
-    def __init__(self, obj = None, ctxt = None):
+    def __init__(self, obj = None, ctxt = None, microtask_queue = False):
         if JSLocker.active:
             self.lock = JSLocker()
             self.lock.enter()
@@ -310,7 +322,7 @@ class JSContext(_STPyV8.JSContext):
         if ctxt:
             _STPyV8.JSContext.__init__(self, ctxt)
         else:
-            _STPyV8.JSContext.__init__(self, obj)
+            _STPyV8.JSContext.__init__(self, obj, microtask_queue)
 
     def __enter__(self):
         self.enter()
@@ -326,8 +338,39 @@ class JSContext(_STPyV8.JSContext):
         del self
 
 
+JSContext.MeasureMemoryExecution = _STPyV8.JSMeasureMemoryExecution
+
+
+class JSContextScope(_STPyV8.JSContextScope):
+    def __enter__(self):
+        self.enter()
+        return self.context
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        self.leave()
+
+    def __bool__(self):
+        return self.entered()
+
+
+class JSContextPool(_STPyV8.JSContextPool):
+    @contextlib.contextmanager
+    def context(self, obj = None):
+        ctxt = self.acquire(obj)
+        ctxt.enter()
+
+        try:
+            yield ctxt
+        finally:
+            ctxt.leave()
+            self.release(ctxt)
+
+
+# The platform options can only be chosen before the platform is initialized
 v8_default_platform = JSPlatform()
-v8_default_platform.init()
+v8_default_platform.init(huge_pages = os.environ.get("STPYV8_HUGE_PAGES") == "1",
+                         prefault = int(os.environ.get("STPYV8_PREFAULT", "0")),
+                         page_accounting = os.environ.get("STPYV8_PAGE_ACCOUNTING") == "1")
 
 v8_default_isolate = JSIsolate()
 v8_default_isolate.enter()
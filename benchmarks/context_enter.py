@@ -0,0 +1,50 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+# Cost of entering and leaving a context: JSContext vs. JSLocker + JSContext vs. JSContextScope
+
+import sys
+import time
+
+import STPyV8
+
+
+def context(count, ctxt):
+    for _ in range(count):
+        with ctxt:
+            pass
+
+
+def locked_context(count, ctxt):
+    for _ in range(count):
+        with STPyV8.JSLocker():
+            with ctxt:
+                pass
+
+
+def scope(count, ctxt, lock):
+    for _ in range(count):
+        with STPyV8.JSContextScope(ctxt, lock):
+            pass
+
+
+def measure(name, func, *args):
+    start = time.perf_counter()
+    func(*args)
+    elapsed = time.perf_counter() - start
+
+    print("%-16s %8.1f ns/enter+leave" % (name, elapsed * 1e9 / args[0]))
+
+
+if __name__ == '__main__':
+    count = int(sys.argv[1]) if len(sys.argv) > 1 else 100000
+
+    with STPyV8.JSIsolate():
+        ctxt = STPyV8.JSContext()
+
+        measure("context", context, count, ctxt)
+        measure("scope", scope, count, ctxt, False)
+
+        # once a Locker was used, V8 expects the isolate to be locked
+        measure("locked context", locked_context, count, ctxt)
+        measure("locked scope", scope, count, ctxt, True)
@@ -0,0 +1,59 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+# Request throughput with a fresh JSContext per request vs. JSContextPool
+
+import sys
+import time
+
+import STPyV8
+
+
+SCRIPT = """
+var items = [];
+for (var i = 0; i < 100; i++) items.push({ id: i, name: 'item' + i });
+JSON.stringify(items).length
+"""
+
+# modern code, the nested const/let and the 'const' in a string don't prevent the reuse
+MODERN_SCRIPT = """
+(function () {
+    const items = [];
+    for (let i = 0; i < 100; i++) items.push({ id: i, name: `item ${i}`, kind: 'const' });
+    return JSON.stringify(items).length;
+})()
+"""
+
+
+class Request(STPyV8.JSClass):
+    path = "/"
+
+
+def fresh(count, script = SCRIPT):
+    for _ in range(count):
+        with STPyV8.JSContext(Request()) as ctxt:
+            ctxt.eval(script)
+
+
+def pooled(count, pool, script = SCRIPT):
+    for _ in range(count):
+        with pool.context(Request()) as ctxt:
+            ctxt.eval(script)
+
+
+def measure(name, func, *args):
+    start = time.perf_counter()
+    func(*args)
+    elapsed = time.perf_counter() - start
+
+    print("%-14s %8.1f requests/s" % (name, args[0] / elapsed))
+
+
+if __name__ == '__main__':
+    count = int(sys.argv[1]) if len(sys.argv) > 1 else 1000
+
+    with STPyV8.JSIsolate():
+        measure("fresh", fresh, count)
+        measure("pooled", pooled, count, STPyV8.JSContextPool(4))
+        measure("fresh modern", fresh, count, MODERN_SCRIPT)
+        measure("pooled modern", pooled, count, STPyV8.JSContextPool(4), MODERN_SCRIPT)
@@ -46,11 +46,22 @@ GN_ARGS = ' '.join("{}={}".format(key, gn_args[key]) for key in gn_args)
 
 source_files = ["Exception.cpp",
                 "Platform.cpp",
+                "PageAllocator.cpp",
+                "Allocator.cpp",
+                "Cache.cpp",
+                "Pool.cpp",
+                "GCStats.cpp",
+                "HeapTuner.cpp",
                 "Isolate.cpp",
                 "Context.cpp",
+                "ContextData.cpp",
+                "ContextPool.cpp",
                 "Engine.cpp",
                 "Wrapper.cpp",
                 "Locker.cpp",
+                "Pressure.cpp",
+                "Watchdog.cpp",
+                "CpuTime.cpp",
                 "Utils.cpp",
                 "STPyV8.cpp"]
 
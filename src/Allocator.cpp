@@ -0,0 +1,62 @@
+#include "Allocator.h"
+
+CArrayBufferAllocator::CArrayBufferAllocator()
+    : m_allocator(v8::ArrayBuffer::Allocator::NewDefaultAllocator()),
+      m_limit(0), m_live(0), m_peak(0), m_total(0)
+{
+}
+
+bool CArrayBufferAllocator::Reserve(size_t length)
+{
+    size_t live = m_live.load(std::memory_order_relaxed);
+    size_t limit = m_limit.load(std::memory_order_relaxed);
+
+    do
+    {
+        if (limit && (length > limit || live > limit - length)) return false;
+    }
+    while (!m_live.compare_exchange_weak(live, live + length, std::memory_order_relaxed));
+
+    size_t peak = m_peak.load(std::memory_order_relaxed);
+
+    while (peak < live + length &&
+            !m_peak.compare_exchange_weak(peak, live + length, std::memory_order_relaxed));
+
+    m_total.fetch_add(length, std::memory_order_relaxed);
+
+    return true;
+}
+
+void CArrayBufferAllocator::Release(size_t length)
+{
+    m_live.fetch_sub(length, std::memory_order_relaxed);
+}
+
+void *CArrayBufferAllocator::Allocate(size_t length)
+{
+    if (!Reserve(length)) return nullptr;
+
+    void *data = m_allocator->Allocate(length);
+
+    if (!data) Release(length);
+
+    return data;
+}
+
+void *CArrayBufferAllocator::AllocateUninitialized(size_t length)
+{
+    if (!Reserve(length)) return nullptr;
+
+    void *data = m_allocator->AllocateUninitialized(length);
+
+    if (!data) Release(length);
+
+    return data;
+}
+
+void CArrayBufferAllocator::Free(void *data, size_t length)
+{
+    m_allocator->Free(data, length);
+
+    Release(length);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include <v8.h>
+
+// ArrayBuffer backing stores live outside of the V8 heap, so the heap limits
+// don't apply to them. CArrayBufferAllocator keeps the per-isolate accounting
+// and fails the allocations (V8 turns them into a RangeError) once the
+// configured limit would be exceeded.
+class CArrayBufferAllocator : public v8::ArrayBuffer::Allocator
+{
+    std::unique_ptr<v8::ArrayBuffer::Allocator> m_allocator;
+
+    std::atomic<size_t> m_limit;
+    std::atomic<size_t> m_live;
+    std::atomic<size_t> m_peak;
+    std::atomic<size_t> m_total;
+
+    bool Reserve(size_t length);
+    void Release(size_t length);
+public:
+    CArrayBufferAllocator();
+    virtual ~CArrayBufferAllocator() {}
+
+    virtual void *Allocate(size_t length) override;
+    virtual void *AllocateUninitialized(size_t length) override;
+    virtual void Free(void *data, size_t length) override;
+
+    size_t GetLimit(void) const {
+        return m_limit;
+    }
+    void SetLimit(size_t limit) {
+        m_limit = limit;
+    }
+
+    size_t GetLiveBytes(void) const {
+        return m_live;
+    }
+    size_t GetPeakBytes(void) const {
+        return m_peak;
+    }
+    size_t GetTotalBytes(void) const {
+        return m_total;
+    }
+};
@@ -0,0 +1,160 @@
+#include "Cache.h"
+
+static const size_t kInitialCapacity = 64;
+
+CTracerCache::CTracerCache()
+    : m_entries(kInitialCapacity, Entry()), m_size(0), m_mask(kInitialCapacity - 1)
+{
+}
+
+ObjectTracer *CTracerCache::Find(PyObject *object, const void *context) const
+{
+    for (size_t i = Slot(object, context); m_entries[i].object; i = (i + 1) & m_mask)
+    {
+        if (m_entries[i].object == object && m_entries[i].context == context) return m_entries[i].tracer;
+    }
+
+    return NULL;
+}
+
+void CTracerCache::Insert(PyObject *object, const void *context, ObjectTracer *tracer)
+{
+    if ((m_size + 1) * 2 > m_entries.size()) Grow();
+
+    size_t i = Slot(object, context);
+
+    while (m_entries[i].object)
+    {
+        if (m_entries[i].object == object && m_entries[i].context == context)
+        {
+            m_entries[i].tracer = tracer;
+
+            return;
+        }
+
+        i = (i + 1) & m_mask;
+    }
+
+    Entry entry = { object, context, tracer };
+
+    m_entries[i] = entry;
+    m_size++;
+}
+
+void CTracerCache::Erase(PyObject *object, const void *context, ObjectTracer *tracer)
+{
+    size_t i = Slot(object, context);
+
+    while (m_entries[i].object)
+    {
+        if (m_entries[i].object == object && m_entries[i].context == context) break;
+
+        i = (i + 1) & m_mask;
+    }
+
+    if (!m_entries[i].object || m_entries[i].tracer != tracer) return;
+
+    // shift back the following entries of the cluster that would become unreachable
+    for (size_t j = (i + 1) & m_mask; m_entries[j].object; j = (j + 1) & m_mask)
+    {
+        size_t home = Slot(m_entries[j].object, m_entries[j].context);
+
+        if (((j - home) & m_mask) >= ((j - i) & m_mask))
+        {
+            m_entries[i] = m_entries[j];
+            i = j;
+        }
+    }
+
+    m_entries[i] = Entry();
+    m_size--;
+}
+
+void CTracerCache::Grow(void)
+{
+    std::vector<Entry> entries(m_entries.size() * 2, Entry());
+
+    entries.swap(m_entries);
+
+    m_mask = m_entries.size() - 1;
+    m_size = 0;
+
+    for (std::vector<Entry>::const_iterator it = entries.begin(); it != entries.end(); it++)
+    {
+        if (it->object) Insert(it->object, it->context, it->tracer);
+    }
+}
+
+const size_t CResultCache::kDefaultCapacity;
+
+PyObject *CResultCache::Find(const std::string& key)
+{
+    std::unordered_map<std::string, Entries::iterator>::const_iterator it = m_index.find(key);
+
+    if (it == m_index.end()) return NULL;
+
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+
+    return it->second->second;
+}
+
+void CResultCache::Insert(const std::string& key, PyObject *result)
+{
+    if (m_capacity == 0) return;
+
+    Py_INCREF(result);
+
+    std::unordered_map<std::string, Entries::iterator>::iterator it = m_index.find(key);
+
+    if (it != m_index.end())
+    {
+        PyObject *replaced = it->second->second;
+
+        it->second->second = result;
+
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+
+        Py_DECREF(replaced);
+
+        return;
+    }
+
+    m_entries.push_front(std::make_pair(key, result));
+    m_index[key] = m_entries.begin();
+
+    Evict(m_capacity);
+}
+
+void CResultCache::Erase(const std::string& prefix)
+{
+    for (Entries::iterator it = m_entries.begin(); it != m_entries.end(); )
+    {
+        if (it->first.compare(0, prefix.size(), prefix) == 0)
+        {
+            PyObject *result = it->second;
+
+            m_index.erase(it->first);
+            it = m_entries.erase(it);
+
+            Py_DECREF(result);
+        }
+        else
+        {
+            it++;
+        }
+    }
+}
+
+void CResultCache::Evict(size_t size)
+{
+    while (m_entries.size() > size)
+    {
+        PyObject *result = m_entries.back().second;
+
+        m_index.erase(m_entries.back().first);
+        m_entries.pop_back();
+
+        // the last reference may run arbitrary code, only once the cache is consistent
+        Py_DECREF(result);
+    }
+}
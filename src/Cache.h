@@ -0,0 +1,99 @@
+#pragma once
+
+#include <Python.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ObjectTracer;
+
+// Per-isolate open-addressing hash table mapping a Python object wrapped in
+// a context to the tracer of its JavaScript wrapper. Linear probing with
+// backward-shift deletion, so lookups never walk tombstones.
+class CTracerCache
+{
+    struct Entry
+    {
+        PyObject *object;
+        const void *context;
+        ObjectTracer *tracer;
+    };
+
+    std::vector<Entry> m_entries;
+    size_t m_size;
+    size_t m_mask;
+
+    size_t Slot(PyObject *object, const void *context) const {
+        uint64_t key = (uint64_t)(uintptr_t) object ^ ((uint64_t)(uintptr_t) context >> 3);
+
+        return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & m_mask;
+    }
+
+    void Grow(void);
+public:
+    CTracerCache();
+
+    ObjectTracer *Find(PyObject *object, const void *context) const;
+
+    // Insert or replace the tracer cached for the object in the context
+    void Insert(PyObject *object, const void *context, ObjectTracer *tracer);
+
+    // Remove the entry only if it still points to the given tracer
+    void Erase(PyObject *object, const void *context, ObjectTracer *tracer);
+
+    size_t Size(void) const {
+        return m_size;
+    }
+};
+
+// Bounded LRU of the Python results of pure evaluations, keyed by the source
+// and the encoded inputs. The results are owned references, so it must only
+// be used with the GIL held.
+class CResultCache
+{
+    typedef std::list<std::pair<std::string, PyObject *> > Entries;
+
+    // most recently used first
+    Entries m_entries;
+    std::unordered_map<std::string, Entries::iterator> m_index;
+    size_t m_capacity;
+
+    void Evict(size_t size);
+
+    CResultCache(const CResultCache&);
+    CResultCache& operator=(const CResultCache&);
+public:
+    static const size_t kDefaultCapacity = 256;
+
+    CResultCache(size_t capacity = kDefaultCapacity) : m_capacity(capacity) {}
+    ~CResultCache() {
+        Clear();
+    }
+
+    // The cached result (borrowed), NULL on a miss
+    PyObject *Find(const std::string& key);
+
+    void Insert(const std::string& key, PyObject *result);
+
+    // Drop the results whose key starts with the prefix
+    void Erase(const std::string& prefix);
+    void Clear(void) {
+        Evict(0);
+    }
+
+    size_t Size(void) const {
+        return m_entries.size();
+    }
+    size_t GetCapacity(void) const {
+        return m_capacity;
+    }
+    void SetCapacity(size_t capacity) {
+        m_capacity = capacity;
+
+        Evict(capacity);
+    }
+};
@@ -1,14 +1,35 @@
 #include "Context.h"
+#include "Watchdog.h"
+#include "ContextData.h"
 #include "Wrapper.h"
 #include "Engine.h"
 
 #include "libplatform/libplatform.h"
 
+#include <chrono>
+#include <thread>
+
 void CContext::Expose(void)
 {
     py::class_<CPlatform, boost::noncopyable>("JSPlatform", "JSPlatform allows the V8 platform to be initialized", py::no_init)
     .def(py::init<std::string>((py::arg("argv") = std::string())))
-    .def("init", &CPlatform::Init, "Initializes the platform")
+    .def("init", &CPlatform::Init, (py::arg("huge_pages") = false,
+                                    py::arg("prefault") = 0,
+                                    py::arg("page_accounting") = false),
+         "Initializes the platform. "
+         "huge_pages asks the kernel to back the V8 reservations with transparent huge pages, "
+         "prefault pre-faults that many bytes of the first read-write pages (the initial heap), "
+         "page_accounting keeps track of the reserved and committed pages; "
+         "any of them installs the custom page allocator.")
+
+    .add_static_property("hugePages", &CPlatform::IsHugePagesEnabled,
+                         "Whether the V8 reservations are backed by transparent huge pages.")
+    .add_static_property("reservedBytes", &CPlatform::GetReservedBytes,
+                         "The bytes of address space reserved by V8 in this process "
+                         "(0 without the custom page allocator).")
+    .add_static_property("committedBytes", &CPlatform::GetCommittedBytes,
+                         "The bytes of the V8 reservations currently accessible "
+                         "(0 without the custom page allocator).")
     ;
 
     py::class_<CIsolate, boost::noncopyable>("JSIsolate", "JSIsolate is an isolated instance of the V8 engine.", py::no_init)
@@ -19,6 +40,19 @@ void CContext::Expose(void)
 
     .add_property("locked", &CIsolate::IsLocked)
 
+    .add_property("arrayBufferLimit", &CIsolate::GetArrayBufferLimit, &CIsolate::SetArrayBufferLimit,
+                  "The maximum bytes of ArrayBuffer backing stores alive in this isolate (0 means unlimited).")
+    .add_property("arrayBufferLive", &CIsolate::GetArrayBufferLiveBytes,
+                  "The bytes of ArrayBuffer backing stores currently alive.")
+    .add_property("arrayBufferPeak", &CIsolate::GetArrayBufferPeakBytes,
+                  "The peak bytes of ArrayBuffer backing stores alive at the same time.")
+    .add_property("arrayBufferTotal", &CIsolate::GetArrayBufferTotalBytes,
+                  "The total bytes of ArrayBuffer backing stores ever allocated.")
+    .add_property("externalMemory", &CIsolate::GetExternalMemory,
+                  "The bytes of memory outside of the V8 heap retained by JavaScript objects.")
+    .add_property("usedHeapSize", &CIsolate::GetUsedHeapSize,
+                  "The bytes of the V8 heap used by live and not yet collected objects.")
+
     .def("GetCurrentStackTrace", &CIsolate::GetCurrentStackTrace)
 
     .def("enter", &CIsolate::Enter,
@@ -29,17 +63,100 @@ void CContext::Expose(void)
     .def("leave", &CIsolate::Leave,
          "Exits this isolate by restoring the previously entered one in the current thread. "
          "The isolate may still stay the same, if it was entered more than once.")
+
+    .def("dispose", &CIsolate::Dispose,
+         "Disposes this isolate and frees its resources, even if it isn't owned by this instance. "
+         "The isolate can't be used anymore. An instance wrapping an existing isolate, "
+         "such as JSIsolate.current, can't dispose it.")
+
+    .def("idle", &CIsolate::Idle, (py::arg("deadline_ms")),
+         "Performs the pending garbage collection work until the deadline (in milliseconds) expires. "
+         "Returns true if there is no more work to do until some real work has been done.")
+
+    .add_property("microtasksPolicy", &CIsolate::GetMicrotasksPolicy, &CIsolate::SetMicrotasksPolicy,
+                  "When the microtasks (promise jobs) run: at the end of each outermost script run or call (auto), "
+                  "when the outermost microtasks scope of an execution exits (scoped) "
+                  "or only when JSContext.runMicrotasks is called (explicit).")
+
+    .add_property("idleTime", &CIsolate::GetIdleTime, &CIsolate::SetIdleTime,
+                  "The milliseconds of garbage collection work automatically performed "
+                  "when the outermost context is left (0 means disabled).")
+
+    .def("writeHeapSnapshot", &CIsolate::WriteHeapSnapshot, (py::arg("path")),
+         "Takes a heap snapshot and streams it to the file in the .heapsnapshot format "
+         "loadable by the Chrome DevTools, without holding the GIL.")
+
+    .def("startHeapTuning", &CIsolate::StartHeapTuning, (py::arg("min_size"), py::arg("max_size")),
+         "Lowers the old generation limit to min_size and lets it follow the GC behaviour, "
+         "growing it up to max_size while the heap fills up and lowering it back "
+         "once the major GCs get rare.")
+    .def("stopHeapTuning", &CIsolate::StopHeapTuning,
+         "Stops the heap tuning, keeping the current limit.")
+    .add_property("heapTuningLog", &CIsolate::GetHeapTuningLog,
+                  "The last decisions of the heap tuner, "
+                  "as (time, action, old_limit, new_limit, reason) tuples.")
+
+    .def("startAllocationSampling", &CIsolate::StartAllocationSampling, (py::arg("interval") = 512 * 1024,
+                                                                         py::arg("depth") = 16),
+         "Starts sampling the allocations, on average one every interval bytes, "
+         "recording up to depth frames of the allocating stack. "
+         "Returns false if the sampling is already running.")
+    .def("stopAllocationSampling", &CIsolate::StopAllocationSampling,
+         "Stops the allocation sampling and returns the tree of the live sampled allocations, "
+         "each node is a (function, script, line, column, self_bytes, children) tuple; "
+         "None if the sampling was not running.")
+
+    .def("gcStats", &CIsolate::GetGCStats,
+         "Returns the GC pauses of this isolate per GC type (count, total and max in milliseconds, "
+         "and a log2 histogram of the pause in microseconds) with the used heap around the last pause.")
+
+    .add_property("gcCallback", &CIsolate::GetGCCallback, &CIsolate::SetGCCallback,
+                  "Called with (type, pause_ms, heap_before, heap_after) after each GC pause, "
+                  "once the outermost execution returns or the pending tasks of the isolate are processed. "
+                  "Only the latest 64 pauses are kept until then.")
+    ;
+
+    py::enum_<v8::MicrotasksPolicy>("JSMicrotasksPolicy")
+    .value("Explicit", v8::MicrotasksPolicy::kExplicit)
+    .value("Scoped", v8::MicrotasksPolicy::kScoped)
+    .value("Auto", v8::MicrotasksPolicy::kAuto)
+    ;
+
+    py::enum_<v8::MeasureMemoryExecution>("JSMeasureMemoryExecution")
+    .value("Default", v8::MeasureMemoryExecution::kDefault)
+    .value("Eager", v8::MeasureMemoryExecution::kEager)
+    .value("Lazy", v8::MeasureMemoryExecution::kLazy)
     ;
 
     py::class_<CContext, boost::noncopyable>("JSContext", "JSContext is an execution context.", py::no_init)
     .def(py::init<const CContext&>("Create a new context based on a existing context"))
-    .def(py::init<py::object>((py::arg("global") = py::object()),
-                              "Create a new context based on global object"))
+    .def(py::init<py::object, bool>((py::arg("global") = py::object(),
+                                     py::arg("microtask_queue") = false),
+                                    "Create a new context based on global object, "
+                                    "with its own microtask queue if microtask_queue is true"))
+
+    .add_property("hasMicrotaskQueue", &CContext::HasMicrotaskQueue,
+                  "Whether the context has its own microtask queue, drained apart from the other contexts.")
 
     .add_property("securityToken", &CContext::GetSecurityToken, &CContext::SetSecurityToken)
 
     .add_property("locals", &CContext::GetGlobal, "Local variables within context")
 
+    .add_property("cpuTime", &CContext::GetCpuTime,
+                  "The thread CPU time (in seconds) spent running this context, "
+                  "including the Python code it calls back. It is accounted from the first "
+                  "access to cpuTime or cpuBudget.")
+    .add_property("cpuBudget", &CContext::GetCpuBudget, &CContext::SetCpuBudget,
+                  "The CPU time (in seconds) this context may use, 0 means unlimited. "
+                  "The execution is terminated and raises JSTimeoutError once the budget is spent.")
+
+    .add_property("statsEnabled", &CContext::IsStatsEnabled, &CContext::SetStatsEnabled,
+                  "Whether the execution statistics of this context are collected.")
+
+    .add_property("identityCache", &CContext::IsIdentityCacheEnabled, &CContext::SetIdentityCache,
+                  "Return the same Python wrapper each time a Javascript object "
+                  "of this context crosses into Python, while that wrapper is alive.")
+
     .add_static_property("entered", &CContext::GetEntered,
                          "The last entered context.")
     .add_static_property("current", &CContext::GetCurrent,
@@ -52,15 +169,55 @@ void CContext::Expose(void)
     .def("eval", &CContext::Evaluate, (py::arg("source"),
                                        py::arg("name") = std::string(),
                                        py::arg("line") = -1,
-                                       py::arg("col") = -1))
+                                       py::arg("col") = -1,
+                                       py::arg("timeout") = 0),
+         "Evaluate the source in this context. "
+         "A positive timeout (in seconds) terminates the execution and raises JSTimeoutError once it expires.")
     .def("eval", &CContext::EvaluateW, (py::arg("source"),
                                         py::arg("name") = std::wstring(),
                                         py::arg("line") = -1,
-                                        py::arg("col") = -1))
+                                        py::arg("col") = -1,
+                                        py::arg("timeout") = 0))
+
+    .def("evalCached", &CContext::EvaluateCached, (py::arg("source"),
+                                                   py::arg("inputs") = py::dict()),
+         "Evaluate a pure source with the inputs (a dict of None, bool, int, float or str) "
+         "bound as variables. The result is memoized by source and inputs, "
+         "and returned again without running any Javascript. "
+         "The input names must be identifiers and not reserved words, or ValueError is raised.")
+    .def("invalidateCached", &CContext::InvalidateCached, (py::arg("source") = py::object()),
+         "Drop the memoized results of the source, or all of them without source.")
+
+    .add_property("evalCacheSize", &CContext::GetCachedCapacity, &CContext::SetCachedCapacity,
+                  "The number of results evalCached keeps, the least recently used go first.")
+
+    .def("measureMemory", &CContext::MeasureMemory, (py::arg("execution") = v8::MeasureMemoryExecution::kEager,
+                                                     py::arg("callback") = py::object(),
+                                                     py::arg("timeout") = 10.0),
+         "Measure the bytes of the V8 heap retained by this context. "
+         "Without a callback it waits for the measurement, at most timeout seconds (0 means forever), "
+         "and returns the size. Otherwise the callback is invoked with the size once the measurement "
+         "completes and the pending platform tasks are run (measureMemory, JSEngine.lowMemory, "
+         "JSIsolate.idle or runMicrotasks).")
 
     .def("enter", &CContext::Enter, "Enter this context. "
          "After entering a context, all code compiled and "
          "run is compiled and run in this context.")
+    .def("dispose", &CContext::Dispose, "Dispose this context: detach its global object, "
+         "drop its cache of Python objects and notify V8, "
+         "so its garbage is reclaimed promptly. The context can't be entered anymore. "
+         "Only the instance which created the context can dispose it, "
+         "not JSContext.current nor a context acquired from a pool.")
+
+    .def("runMicrotasks", &CContext::RunMicrotasks, "Run the pending microtasks (promise jobs) until none is left, "
+         "whatever the microtasks policy of the isolate. "
+         "Only the queue of this context is drained when it has its own.")
+    .def("performMicrotaskCheckpoint", &CContext::RunMicrotasks, "Alias of runMicrotasks.")
+
+    .def("stats", &CContext::GetStats, "Return the execution statistics of this context, "
+                                       "the times are in seconds.")
+    .def("resetStats", &CContext::ResetStats, "Reset the execution statistics of this context.")
+
     .def("leave", &CContext::Leave, "Exit this context. "
          "Exiting the current context restores the context "
          "that was in place when entering the current context.")
@@ -82,6 +239,7 @@ void CContext::Expose(void)
 }
 
 CContext::CContext(v8::Handle<v8::Context> context)
+    : m_isolate(context->GetIsolate()), m_owner(false), m_entered(0)
 {
     v8::HandleScope handle_scope(v8::Isolate::GetCurrent());
 
@@ -89,45 +247,365 @@ CContext::CContext(v8::Handle<v8::Context> context)
 }
 
 CContext::CContext(const CContext& context)
+    : m_isolate(context.m_isolate), m_owner(false), m_entered(0)
 {
     v8::HandleScope handle_scope(v8::Isolate::GetCurrent());
 
     m_context.Reset(context.Handle()->GetIsolate(), context.Handle());
 }
 
-CContext::CContext(py::object global)
-    : m_global(global)
+CContext::CContext(py::object global, bool microtask_queue)
+    : m_global(global), m_isolate(v8::Isolate::GetCurrent()), m_owner(true), m_entered(0)
 {
     v8::Isolate* isolate = v8::Isolate::GetCurrent();
     v8::HandleScope handle_scope(isolate);
 
-    v8::Handle<v8::Context> context = v8::Context::New(isolate);
+    v8::MaybeLocal<v8::ObjectTemplate> global_template;
+
+    // the global object resolves the missing globals straight in the Python object
+    if (!global.is_none()) global_template = CPythonObject::GetGlobalTemplate(isolate);
+
+    std::unique_ptr<v8::MicrotaskQueue> queue;
+
+    // the promise jobs of the context don't wait behind (nor delay) the other contexts
+    if (microtask_queue) queue = v8::MicrotaskQueue::New(isolate, isolate->GetMicrotasksPolicy());
+
+    v8::Handle<v8::Context> context = v8::Context::New(isolate, NULL, global_template, v8::MaybeLocal<v8::Value>(),
+                                      v8::DeserializeInternalFieldsCallback(), queue.get());
+
+    CContextData::InitEmbedderData(context);
+
+    CPythonObject::BindGlobal(context, global);
+
+    if (queue) CContextData::Get(context)->microtask_queue = std::move(queue);
 
     m_context.Reset(isolate, context);
+}
+
+CContext::~CContext()
+{
+    if (m_owner && !m_context.IsEmpty()) NotifyDisposed();
 
+    m_context.Reset();
+}
+
+void CContext::NotifyDisposed(void)
+{
+    // the last reference may go away while another isolate is entered
+    v8::Isolate::Scope isolate_scope(m_isolate);
+    v8::HandleScope handle_scope(m_isolate);
+
+    // V8 drops the retained maps and finalization registries of the current context
     v8::Context::Scope context_scope(Handle());
 
-    if (!global.is_none())
+    m_isolate->ContextDisposedNotification();
+}
+
+void CContext::Dispose(void)
+{
+    if (m_context.IsEmpty()) return;
+
+    // a pooled context goes back through its pool, a wrapped one stays with its owner
+    if (!m_owner) throw CJavascriptException("can't dispose a context owned by another instance", ::PyExc_RuntimeError);
+
+    v8::HandleScope handle_scope(m_isolate);
+
+    v8::Handle<v8::Context> context = Handle();
+
+    if (m_entered > 0 || (m_isolate->InContext() && m_isolate->GetCurrentContext() == context))
     {
-        v8::Maybe<bool> retcode =
-            Handle()->Global()->Set(context,
-                                    v8::String::NewFromUtf8(isolate, "__proto__").ToLocalChecked(),
-                                    CPythonObject::Wrap(global));
-        if(retcode.IsNothing()) {
-            //TODO we need to do something if the set call failed
+        throw CJavascriptException("can't dispose an entered context", ::PyExc_RuntimeError);
+    }
+
+#ifdef SUPPORT_TRACE_LIFECYCLE
+    ContextTracer::Dispose(context);
+#endif
+
+    CPythonObject::UnbindGlobal(context);
+
+    context->DetachGlobal();
+
+    NotifyDisposed();
+
+    m_context.Reset();
+    m_global = py::object();
+    m_results.reset();
+    m_wrappers.reset();
+}
+
+struct CMemoryMeasurement
+{
+    bool done;
+    size_t size;
+
+    CMemoryMeasurement() : done(false), size(0) {}
+};
+
+class CContextMemoryDelegate : public v8::MeasureMemoryDelegate
+{
+    v8::Global<v8::Context> m_context;
+    std::shared_ptr<CMemoryMeasurement> m_measurement;
+    py::object m_callback;
+public:
+    CContextMemoryDelegate(v8::Isolate *isolate, v8::Handle<v8::Context> context,
+                           std::shared_ptr<CMemoryMeasurement> measurement, py::object callback)
+        : m_context(isolate, context), m_measurement(measurement), m_callback(callback)
+    {
+    }
+
+    virtual ~CContextMemoryDelegate()
+    {
+        CPythonGIL python_gil;
+
+        m_callback = py::object();
+    }
+
+    virtual bool ShouldMeasure(v8::Local<v8::Context> context) override
+    {
+        return m_context == context;
+    }
+
+    virtual void MeasurementComplete(const std::vector<std::pair<v8::Local<v8::Context>, size_t> >& context_sizes_in_bytes,
+                                     size_t UNUSED_VAR(unattributed_size_in_bytes)) override
+    {
+        for (auto& it : context_sizes_in_bytes)
+        {
+            if (m_context == it.first) m_measurement->size = it.second;
+        }
+
+        m_measurement->done = true;
+
+        if (m_callback.is_none()) return;
+
+        CPythonGIL python_gil;
+
+        try
+        {
+            m_callback(m_measurement->size);
+        }
+        catch (const py::error_already_set&)
+        {
+            ::PyErr_Print();
         }
+    }
+};
+
+bool CContext::IsIdentityCacheEnabled(void)
+{
+#ifdef SUPPORT_TRACE_LIFECYCLE
+    if (m_context.IsEmpty()) return false;
+
+    v8::HandleScope handle_scope(m_isolate);
+
+    ContextTracer *tracer = ContextTracer::Find(Handle());
+
+    return tracer && tracer->IsIdentityCacheEnabled();
+#else
+    return false;
+#endif
+}
+
+void CContext::SetIdentityCache(bool enabled)
+{
+#ifdef SUPPORT_TRACE_LIFECYCLE
+    v8::HandleScope handle_scope(v8::Isolate::GetCurrent());
+
+    ContextTracer::Get(Handle())->SetIdentityCache(enabled);
+#else
+    if (enabled) throw CJavascriptException("identity cache requires lifecycle tracing", ::PyExc_NotImplementedError);
+#endif
+}
+
+py::object CContext::MeasureMemory(v8::MeasureMemoryExecution execution, py::object callback, double timeout)
+{
+    v8::Isolate* isolate = v8::Isolate::GetCurrent();
+    v8::HandleScope handle_scope(isolate);
+
+    if (callback.is_none() && execution == v8::MeasureMemoryExecution::kLazy)
+        throw CJavascriptException("lazy memory measurement requires a callback", ::PyExc_ValueError);
+
+    std::shared_ptr<CMemoryMeasurement> measurement(new CMemoryMeasurement());
+    std::unique_ptr<v8::MeasureMemoryDelegate> delegate(new CContextMemoryDelegate(isolate, Handle(), measurement, callback));
+
+    if (!isolate->MeasureMemory(std::move(delegate), execution))
+        throw CJavascriptException("fail to start the memory measurement", ::PyExc_RuntimeError);
+
+    if (!callback.is_none()) return py::object();
+
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() +
+        std::chrono::microseconds((int64_t) (timeout * 1e6));
+
+    // The measurement piggybacks on a GC driven by the platform tasks,
+    // so keep pumping them until the delegate reports back
+    while (!measurement->done)
+    {
+        if (CPlatform::PumpMessageLoop(isolate)) continue;
+
+        if (timeout > 0 && std::chrono::steady_clock::now() >= deadline)
+            throw CJavascriptException("the memory measurement timed out", ::PyExc_TimeoutError);
+
+        Py_BEGIN_ALLOW_THREADS
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        Py_END_ALLOW_THREADS
+    }
+
+    return py::object(measurement->size);
+}
+
+void CContext::RunMicrotasks(void)
+{
+    if (m_context.IsEmpty()) throw CJavascriptException("the context has been disposed", ::PyExc_RuntimeError);
+
+    v8::HandleScope handle_scope(m_isolate);
+    v8::Context::Scope context_scope(Handle());
+
+    Py_BEGIN_ALLOW_THREADS
 
-        Py_DECREF(global.ptr());
+    v8::MicrotaskQueue *queue = CContextData::GetMicrotaskQueue(Handle());
+
+    if (queue)
+    {
+        queue->PerformCheckpoint(m_isolate);
+    }
+    else
+    {
+        m_isolate->PerformMicrotaskCheckpoint();
+    }
+
+    Py_END_ALLOW_THREADS
+
+    CPlatform::PumpMessageLoop(m_isolate);
+}
+
+void CContext::Leave(void)
+{
+    // disposed through this instance, there is nothing left to leave
+    if (m_context.IsEmpty()) return;
+
+    Raw()->Exit();
+
+    if (m_entered > 0) m_entered--;
+
+    // Leaving the outermost context means the isolate has nothing to run,
+    // which is the right time to do the GC work in the configured idle time
+    if (!m_isolate->InContext())
+    {
+        CIsolate owner(m_isolate);
+
+        if (owner.GetIdleTime() > 0) owner.Idle(owner.GetIdleTime());
     }
 }
 
 py::object CContext::GetGlobal(void)
 {
+    if (m_context.IsEmpty()) return py::object();
+
     v8::HandleScope handle_scope(v8::Isolate::GetCurrent());
 
     return CJavascriptObject::Wrap(Handle()->Global());
 }
 
+bool CContext::HasMicrotaskQueue(void)
+{
+    if (m_context.IsEmpty()) return false;
+
+    v8::HandleScope handle_scope(m_isolate);
+
+    return CContextData::GetMicrotaskQueue(Handle()) != NULL;
+}
+
+double CContext::GetCpuTime(void)
+{
+    if (m_context.IsEmpty()) return 0;
+
+    v8::HandleScope handle_scope(m_isolate);
+
+    return CContextData::Get(Handle())->cpu_time / 1e9;
+}
+
+double CContext::GetCpuBudget(void)
+{
+    if (m_context.IsEmpty()) return 0;
+
+    v8::HandleScope handle_scope(m_isolate);
+
+    return CContextData::Get(Handle())->cpu_budget / 1e9;
+}
+
+void CContext::SetCpuBudget(double budget)
+{
+    if (m_context.IsEmpty()) throw CJavascriptException("the context has been disposed", ::PyExc_RuntimeError);
+    if (budget < 0) throw CJavascriptException("the budget can't be negative", ::PyExc_ValueError);
+
+    v8::HandleScope handle_scope(m_isolate);
+
+    CContextData::Get(Handle())->cpu_budget = (int64_t) (budget * 1e9);
+}
+
+bool CContext::IsStatsEnabled(void)
+{
+    if (m_context.IsEmpty()) return false;
+
+    v8::HandleScope handle_scope(m_isolate);
+
+    CContextData *data = CContextData::Find(Handle());
+
+    return data && data->stats.enabled;
+}
+
+void CContext::SetStatsEnabled(bool enabled)
+{
+    if (m_context.IsEmpty()) throw CJavascriptException("the context has been disposed", ::PyExc_RuntimeError);
+
+    v8::HandleScope handle_scope(m_isolate);
+
+    CContextStats& stats = CContextData::Get(Handle())->stats;
+
+    if (stats.enabled == enabled) return;
+
+    stats.enabled = enabled;
+
+    if (enabled)
+        CContextStats::s_collecting++;
+    else
+        CContextStats::s_collecting--;
+}
+
+py::dict CContext::GetStats(void)
+{
+    py::dict result;
+
+    if (m_context.IsEmpty()) return result;
+
+    v8::HandleScope handle_scope(m_isolate);
+
+    CContextData *data = CContextData::Find(Handle());
+    CContextStats stats = data ? data->stats : CContextStats();
+
+    result["evals"] = stats.evals;
+    result["calls"] = stats.calls;
+    result["callbacks"] = stats.callbacks;
+    result["exceptions"] = stats.exceptions;
+    result["compileTime"] = stats.compile_time / 1e9;
+    result["runTime"] = stats.run_time / 1e9;
+    result["callbackTime"] = stats.callback_time / 1e9;
+
+    return result;
+}
+
+void CContext::ResetStats(void)
+{
+    if (m_context.IsEmpty()) return;
+
+    v8::HandleScope handle_scope(m_isolate);
+
+    CContextData *data = CContextData::Find(Handle());
+
+    if (data) data->stats.Reset();
+}
+
 py::str CContext::GetSecurityToken(void)
 {
     v8::Isolate* isolate = v8::Isolate::GetCurrent();
@@ -193,22 +671,194 @@ py::object CContext::GetCalling(void)
 
 py::object CContext::Evaluate(const std::string& src,
                               const std::string name,
-                              int line, int col)
+                              int line, int col, double timeout)
+{
+    v8::Isolate *isolate = v8::Isolate::GetCurrent();
+    v8::HandleScope handle_scope(isolate);
+
+    // no CScript and no persistent handles, the script only lives in this scope
+    return CWatchdog::Run(isolate, timeout, [&]() {
+        return CEngine(isolate).Evaluate(ToString(src), ToString(name), line, col);
+    });
+}
+
+// The key prefix of the results of a source
+static std::string CachedSourceKey(const std::string& src)
+{
+    return std::to_string(src.size()) + ":" + src;
+}
+
+// Append a canonical encoding of an input, which tells apart 1, 1.0, True and "1"
+static void EncodeCachedInput(std::string& key, PyObject *value)
+{
+    if (value == Py_None)
+    {
+        key += "N";
+
+        return;
+    }
+
+    if (PyBool_Check(value))
+    {
+        key += value == Py_True ? "T" : "F";
+
+        return;
+    }
+
+    char tag;
+    py::object text;
+
+    if (PyLong_Check(value))
+    {
+        tag = 'i';
+        text = py::object(py::handle<>(::PyObject_Str(value)));
+    }
+    else if (PyFloat_Check(value))
+    {
+        // repr round-trips the exact value
+        tag = 'f';
+        text = py::object(py::handle<>(::PyObject_Repr(value)));
+    }
+    else if (PyUnicode_Check(value))
+    {
+        tag = 's';
+        text = py::object(py::handle<>(py::borrowed(value)));
+    }
+    else
+    {
+        throw CJavascriptException("only None, bool, int, float and str inputs can be cached", ::PyExc_TypeError);
+    }
+
+    Py_ssize_t size = 0;
+    const char *data = ::PyUnicode_AsUTF8AndSize(text.ptr(), &size);
+
+    if (!data) throw py::error_already_set();
+
+    key += tag;
+    key += std::to_string(size);
+    key += ':';
+    key.append(data, size);
+}
+
+// Whether the name is a reserved word of Javascript, or can't name a parameter in strict mode
+static bool IsReservedName(PyObject *name)
+{
+    static const char *reserved[] = {
+        "await", "break", "case", "catch", "class", "const", "continue", "debugger", "default",
+        "delete", "do", "else", "enum", "export", "extends", "false", "finally", "for", "function",
+        "if", "import", "in", "instanceof", "new", "null", "return", "super", "switch", "this",
+        "throw", "true", "try", "typeof", "var", "void", "while", "with", "yield",
+        "implements", "interface", "let", "package", "private", "protected", "public", "static",
+        "arguments", "eval"
+    };
+
+    for (size_t i = 0; i < _countof(reserved); i++)
+    {
+        if (::PyUnicode_CompareWithASCIIString(name, reserved[i]) == 0) return true;
+    }
+
+    return false;
+}
+
+py::object CContext::EvaluateCached(const std::string& src, py::dict inputs)
+{
+    py::list names = inputs.keys();
+    Py_ssize_t count = ::PyList_Size(names.ptr());
+
+    for (Py_ssize_t i = 0; i < count; i++)
+    {
+        PyObject *name = PyList_GET_ITEM(names.ptr(), i);
+
+        if (!PyUnicode_Check(name) || !::PyUnicode_IsIdentifier(name) || IsReservedName(name))
+        {
+            throw CJavascriptException("the input names must be identifiers and not reserved words", ::PyExc_ValueError);
+        }
+    }
+
+    names.sort();
+
+    std::string key = CachedSourceKey(src), params;
+    py::list args;
+
+    for (Py_ssize_t i = 0; i < count; i++)
+    {
+        py::object name = names[i], value = inputs[name];
+
+        EncodeCachedInput(key, name.ptr());
+        EncodeCachedInput(key, value.ptr());
+
+        if (i) params += ", ";
+        params += py::extract<std::string>(name)();
+
+        args.append(value);
+    }
+
+    if (!m_results) m_results.reset(new CResultCache());
+
+    PyObject *cached = m_results->Find(key);
+
+    if (cached) return py::object(py::handle<>(py::borrowed(cached)));
+
+    if (!m_wrappers) m_wrappers.reset(new CResultCache());
+
+    PyObject *wrapper = m_wrappers->Find(params);
+    py::object func;
+
+    if (wrapper)
+    {
+        func = py::object(py::handle<>(py::borrowed(wrapper)));
+    }
+    else
+    {
+        // the inputs are parameters of a function, whose direct eval keeps the completion value of the source
+        func = Evaluate("(function (" + params + ") { return eval(arguments[" + std::to_string(count) + "]); })");
+
+        m_wrappers->Insert(params, func.ptr());
+    }
+
+    args.append(src);
+
+    py::object result(py::handle<>(::PyObject_CallObject(func.ptr(), py::tuple(args).ptr())));
+
+    m_results->Insert(key, result.ptr());
+
+    return result;
+}
+
+void CContext::InvalidateCached(py::object src)
 {
-    CEngine engine(v8::Isolate::GetCurrent());
+    if (!m_results) return;
 
-    CScriptPtr script = engine.Compile(src, name, line, col);
+    if (src.is_none())
+    {
+        m_results->Clear();
+    }
+    else
+    {
+        m_results->Erase(CachedSourceKey(py::extract<std::string>(src)));
+    }
+}
 
-    return script->Run();
+size_t CContext::GetCachedCapacity(void)
+{
+    return m_results ? m_results->GetCapacity() : CResultCache::kDefaultCapacity;
+}
+
+void CContext::SetCachedCapacity(size_t capacity)
+{
+    if (!m_results) m_results.reset(new CResultCache(capacity));
+
+    m_results->SetCapacity(capacity);
 }
 
 py::object CContext::EvaluateW(const std::wstring& src,
                                const std::wstring name,
-                               int line, int col)
+                               int line, int col, double timeout)
 {
-    CEngine engine(v8::Isolate::GetCurrent());
-
-    CScriptPtr script = engine.CompileW(src, name, line, col);
+    v8::Isolate *isolate = v8::Isolate::GetCurrent();
+    v8::HandleScope handle_scope(isolate);
 
-    return script->Run();
+    return CWatchdog::Run(isolate, timeout, [&]() {
+        return CEngine(isolate).Evaluate(ToString(src), ToString(name), line, col);
+    });
 }
@@ -20,22 +20,61 @@ class CContext
 {
     py::object m_global;
     v8::Persistent<v8::Context> m_context;
+
+    // the context was created by this instance, which notifies V8 when dropping it
+    v8::Isolate *m_isolate;
+    bool m_owner;
+
+    // how many times this instance was entered and not left yet
+    int m_entered;
+
+    // results of evalCached, created on first use
+    std::unique_ptr<CResultCache> m_results;
+    // the compiled functions evalCached binds the inputs with, by parameter list
+    std::unique_ptr<CResultCache> m_wrappers;
+
+    void NotifyDisposed(void);
+
+    friend class CContextPool;
 public:
     CContext(v8::Handle<v8::Context> context);
     CContext(const CContext& context);
-    CContext(py::object global);
+    CContext(py::object global, bool microtask_queue = false);
 
-    ~CContext()
-    {
-        m_context.Reset();
-    }
+    ~CContext();
+
+    // Detach the global, drop the cached Python objects and tell V8 the context is gone
+    void Dispose(void);
 
     v8::Handle<v8::Context> Handle(void) const {
-        return v8::Local<v8::Context>::New(v8::Isolate::GetCurrent(), m_context);
+        return v8::Local<v8::Context>::New(m_isolate, m_context);
+    }
+
+    // The context without allocating a handle, only valid as long as the persistent handle is alive
+    v8::Local<v8::Context> Raw(void) const {
+        return *reinterpret_cast<v8::Local<v8::Context> *>(const_cast<v8::Persistent<v8::Context> *>(&m_context));
+    }
+
+    v8::Isolate *GetIsolate(void) const {
+        return m_isolate;
     }
 
     py::object GetGlobal(void);
 
+    double GetCpuTime(void);
+    double GetCpuBudget(void);
+    void SetCpuBudget(double budget);
+
+    bool IsStatsEnabled(void);
+    void SetStatsEnabled(bool enabled);
+    py::dict GetStats(void);
+    void ResetStats(void);
+
+    py::object MeasureMemory(v8::MeasureMemoryExecution execution, py::object callback, double timeout = 10.0);
+
+    bool IsIdentityCacheEnabled(void);
+    void SetIdentityCache(bool enabled);
+
     py::str GetSecurityToken(void);
     void SetSecurityToken(py::str token);
 
@@ -43,18 +82,29 @@ public:
         return !m_context.IsEmpty();
     }
     void Enter(void) {
-        v8::HandleScope handle_scope(v8::Isolate::GetCurrent());
-        Handle()->Enter();
-    }
-    void Leave(void) {
-        v8::HandleScope handle_scope(v8::Isolate::GetCurrent());
-        Handle()->Exit();
+        if (m_context.IsEmpty()) throw CJavascriptException("the context has been disposed", ::PyExc_RuntimeError);
+
+        Raw()->Enter();
+
+        m_entered++;
     }
+    void Leave(void);
+
+    // Run the pending microtasks (promise jobs) now, whatever the microtasks policy
+    void RunMicrotasks(void);
+    bool HasMicrotaskQueue(void);
 
     py::object Evaluate(const std::string& src, const std::string name = std::string(),
-                        int line = -1, int col = -1);
+                        int line = -1, int col = -1, double timeout = 0);
     py::object EvaluateW(const std::wstring& src, const std::wstring name = std::wstring(),
-                         int line = -1, int col = -1);
+                         int line = -1, int col = -1, double timeout = 0);
+
+    // Evaluate a pure source with primitive inputs, memoizing the results
+    py::object EvaluateCached(const std::string& src, py::dict inputs = py::dict());
+    void InvalidateCached(py::object src = py::object());
+
+    size_t GetCachedCapacity(void);
+    void SetCachedCapacity(size_t capacity);
 
     static py::object GetEntered(void);
     static py::object GetCurrent(void);
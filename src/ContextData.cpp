@@ -0,0 +1,54 @@
+#include "ContextData.h"
+
+std::atomic<int> CContextStats::s_collecting(0);
+
+CContextStats *CContextStats::Get(v8::Handle<v8::Context> ctxt)
+{
+    if (s_collecting.load(std::memory_order_relaxed) == 0 || ctxt.IsEmpty()) return NULL;
+
+    CContextData *data = CContextData::Find(ctxt);
+
+    return data && data->stats.enabled ? &data->stats : NULL;
+}
+
+CContextStats *CContextStats::Current(v8::Isolate *isolate)
+{
+    if (s_collecting.load(std::memory_order_relaxed) == 0 || !isolate->InContext()) return NULL;
+
+    return Get(isolate->GetCurrentContext());
+}
+
+CContextData *CContextData::Find(v8::Handle<v8::Context> ctxt)
+{
+    if (ctxt->GetNumberOfEmbedderDataFields() <= kEmbedderDataIndex) return NULL;
+
+    return static_cast<CContextData *>(ctxt->GetAlignedPointerFromEmbedderData(kEmbedderDataIndex));
+}
+
+CContextData *CContextData::Get(v8::Handle<v8::Context> ctxt)
+{
+    CContextData *data = Find(ctxt);
+
+    if (data) return data;
+
+    std::unique_ptr<CContextData> created(new CContextData());
+
+    created->m_context.Reset(ctxt->GetIsolate(), ctxt);
+    created->m_context.SetWeak(created.get(), WeakCallback, v8::WeakCallbackType::kParameter);
+
+    ctxt->SetAlignedPointerInEmbedderData(kEmbedderDataIndex, created.get());
+
+    return created.release();
+}
+
+void CContextData::WeakCallback(const v8::WeakCallbackInfo<CContextData>& info)
+{
+    info.GetParameter()->m_context.Reset();
+    info.SetSecondPassCallback(DisposeCallback);
+}
+
+void CContextData::DisposeCallback(const v8::WeakCallbackInfo<CContextData>& info)
+{
+    // the microtask queue has to go with the V8 heap available
+    delete info.GetParameter();
+}
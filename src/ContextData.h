@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include <v8.h>
+
+// Execution counters of a context, only collected once enabled
+struct CContextStats
+{
+    bool enabled;
+
+    // scripts run, Javascript functions called from Python, Python objects called back from Javascript
+    uint64_t evals, calls, callbacks;
+    // scripts which failed to compile or raised an exception
+    uint64_t exceptions;
+    // wall time spent compiling, running and in the callbacks, in nanoseconds
+    int64_t compile_time, run_time, callback_time;
+
+    CContextStats() : enabled(false) { Reset(); }
+
+    void Reset(void) {
+        evals = calls = callbacks = exceptions = 0;
+        compile_time = run_time = callback_time = 0;
+    }
+
+    // the number of contexts collecting statistics, nothing is looked up as long as there is none
+    static std::atomic<int> s_collecting;
+
+    // The statistics of the context, NULL when it doesn't collect them
+    static CContextStats *Get(v8::Handle<v8::Context> ctxt);
+    // The statistics of the current context of the isolate, if any
+    static CContextStats *Current(v8::Isolate *isolate);
+};
+
+// Adds the wall time spent while alive to a counter, does nothing without one
+class CStatsTimer
+{
+    int64_t *m_total;
+    std::chrono::steady_clock::time_point m_start;
+public:
+    CStatsTimer(int64_t *total) : m_total(total) {
+        if (m_total) m_start = std::chrono::steady_clock::now();
+    }
+    ~CStatsTimer() {
+        if (m_total) *m_total += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+    }
+};
+
+// Counts a Python callback of the current context and the time spent in it
+class CCallbackStats
+{
+    CContextStats *m_stats;
+    CStatsTimer m_timer;
+public:
+    CCallbackStats(v8::Isolate *isolate)
+        : m_stats(CContextStats::Current(isolate)),
+          m_timer(m_stats ? (m_stats->callbacks++, &m_stats->callback_time) : NULL) {}
+};
+
+// Per-context state kept in the context embedder data, released with the context
+struct CContextData
+{
+    static const int kEmbedderDataIndex = 3;
+
+    // thread CPU time spent running the context (and the Python code it calls back), in nanoseconds
+    int64_t cpu_time;
+    // the CPU time the context may use (0 means unlimited)
+    int64_t cpu_budget;
+
+    // the own microtask queue of the context, NULL when it uses the queue of the isolate
+    std::unique_ptr<v8::MicrotaskQueue> microtask_queue;
+
+    CContextStats stats;
+
+    // the context is reused by a pool, which can't reset the top level let/const/class bindings
+    bool pooled;
+    // a script run in the pooled context may have declared such a binding
+    bool lexical;
+
+    CContextData() : cpu_time(0), cpu_budget(0), pooled(false), lexical(false) {}
+    ~CContextData() {
+        if (stats.enabled) CContextStats::s_collecting--;
+    }
+
+    // Forget the usage of the previous owner of a reused context
+    void Reset(void) {
+        cpu_time = 0;
+        cpu_budget = 0;
+        stats.Reset();
+    }
+
+    // Clear the embedder data slots of a new context before any is read. V8 fills
+    // them with undefined, which isn't a NULL aligned pointer; this slot is the last one in use
+    static void InitEmbedderData(v8::Handle<v8::Context> ctxt) {
+        for (int i = 1; i <= kEmbedderDataIndex; i++) ctxt->SetAlignedPointerInEmbedderData(i, NULL);
+    }
+
+    // The data of the context, created on first use
+    static CContextData *Get(v8::Handle<v8::Context> ctxt);
+    // The data of the context, NULL if it was never used
+    static CContextData *Find(v8::Handle<v8::Context> ctxt);
+
+    // The queue the microtasks of the context go to, NULL for the default queue of the isolate
+    static v8::MicrotaskQueue *GetMicrotaskQueue(v8::Handle<v8::Context> ctxt) {
+        CContextData *data = Find(ctxt);
+
+        return data ? data->microtask_queue.get() : NULL;
+    }
+private:
+    v8::Global<v8::Context> m_context;
+
+    static void WeakCallback(const v8::WeakCallbackInfo<CContextData>& info);
+    static void DisposeCallback(const v8::WeakCallbackInfo<CContextData>& info);
+};
@@ -0,0 +1,230 @@
+#include "ContextPool.h"
+#include "ContextData.h"
+
+void CContextPool::Expose(void)
+{
+    py::class_<CContextPool, boost::noncopyable>("JSContextPool", "JSContextPool hands out pre-created contexts "
+            "and resets them when they are released.", py::no_init)
+    .def(py::init<size_t>((py::arg("size") = 4), "Create a pool keeping up to size idle contexts of the current isolate."))
+
+    .add_property("size", &CContextPool::GetSize, "The maximum number of idle contexts.")
+    .add_property("idle", &CContextPool::GetIdle, "The number of contexts ready to be acquired.")
+    .add_property("busy", &CContextPool::GetBusy, "The number of contexts acquired and not released yet.")
+
+    .def("acquire", &CContextPool::Acquire, (py::arg("global") = py::object()),
+         "Take a context from the pool (or create one) bound to the global object.")
+    .def("release", &CContextPool::Release, (py::arg("context")),
+         "Give the context back to the pool, which resets it. "
+         "The released context can't be entered anymore.")
+    ;
+}
+
+CContextPool::CContextPool(size_t size)
+    : m_isolate(v8::Isolate::GetCurrent()), m_size(size)
+{
+    for (size_t i = 0; i < m_size; i++) m_idle.push_back(std::unique_ptr<Entry>(Create()));
+}
+
+CContextPool::Entry *CContextPool::Create(void)
+{
+    v8::HandleScope handle_scope(m_isolate);
+
+    v8::Local<v8::Context> context = v8::Context::New(m_isolate, NULL, CPythonObject::GetGlobalTemplate(m_isolate));
+    v8::Context::Scope context_scope(context);
+
+    CContextData::InitEmbedderData(context);
+    CContextData::Get(context)->pooled = true;
+
+    v8::Local<v8::Object> global = context->Global();
+    v8::Local<v8::Object> values = v8::Object::New(m_isolate, v8::Null(m_isolate), NULL, NULL, 0);
+    v8::Local<v8::Object> attributes = v8::Object::New(m_isolate, v8::Null(m_isolate), NULL, NULL, 0);
+
+    v8::Local<v8::Array> names = global->GetOwnPropertyNames(context, v8::ALL_PROPERTIES,
+                                 v8::KeyConversionMode::kConvertToString).ToLocalChecked();
+
+    for (uint32_t i = 0; i < names->Length(); i++)
+    {
+        v8::Local<v8::Value> name = names->Get(context, i).ToLocalChecked();
+        v8::Local<v8::Value> value;
+        v8::PropertyAttribute attribute;
+
+        if (global->Get(context, name).ToLocal(&value) &&
+            global->GetPropertyAttributes(context, name).To(&attribute))
+        {
+            values->CreateDataProperty(context, name.As<v8::Name>(), value).Check();
+            attributes->CreateDataProperty(context, name.As<v8::Name>(), v8::Integer::New(m_isolate, attribute)).Check();
+        }
+    }
+
+    std::unique_ptr<Entry> entry(new Entry());
+
+    entry->context.Reset(m_isolate, context);
+    entry->prototype.Reset(m_isolate, global->Get(context, v8::String::NewFromUtf8(m_isolate, "__proto__").ToLocalChecked()).ToLocalChecked());
+
+    // the pristine Object.setPrototypeOf, which looks through the global proxy unlike Object::SetPrototype
+    v8::Local<v8::Object> object = global->Get(context, v8::String::NewFromUtf8(m_isolate, "Object").ToLocalChecked())
+                                   .ToLocalChecked().As<v8::Object>();
+
+    entry->set_prototype.Reset(m_isolate, object->Get(context, v8::String::NewFromUtf8(m_isolate, "setPrototypeOf").ToLocalChecked())
+                               .ToLocalChecked().As<v8::Function>());
+    entry->values.Reset(m_isolate, values);
+    entry->attributes.Reset(m_isolate, attributes);
+
+    return entry.release();
+}
+
+void CContextPool::Reset(Entry *entry)
+{
+    v8::HandleScope handle_scope(m_isolate);
+
+    v8::Local<v8::Context> context = v8::Local<v8::Context>::New(m_isolate, entry->context);
+    v8::Context::Scope context_scope(context);
+
+    v8::TryCatch try_catch(m_isolate);
+
+#ifdef SUPPORT_TRACE_LIFECYCLE
+    ContextTracer::Dispose(context);
+#endif
+
+    v8::Local<v8::Object> global = context->Global();
+    v8::Local<v8::Object> values = v8::Local<v8::Object>::New(m_isolate, entry->values);
+    v8::Local<v8::Object> attributes = v8::Local<v8::Object>::New(m_isolate, entry->attributes);
+
+    CPythonObject::UnbindGlobal(context);
+
+    CContextData::Get(context)->Reset();
+
+    // neither Set nor a setter the request installed on the global object
+    v8::Local<v8::Value> args[] = { global, v8::Local<v8::Value>::New(m_isolate, entry->prototype) };
+
+    if (v8::Local<v8::Function>::New(m_isolate, entry->set_prototype)->Call(context, v8::Undefined(m_isolate), 2, args).IsEmpty())
+    {
+        try_catch.Reset();
+    }
+
+    v8::Local<v8::Array> names;
+
+    // drop what the request added, the var declarations can't be deleted
+    if (global->GetOwnPropertyNames(context, v8::ALL_PROPERTIES, v8::KeyConversionMode::kConvertToString).ToLocal(&names))
+    {
+        for (uint32_t i = 0; i < names->Length(); i++)
+        {
+            v8::Local<v8::Value> name = names->Get(context, i).ToLocalChecked();
+
+            if (values->HasOwnProperty(context, name.As<v8::Name>()).FromMaybe(true)) continue;
+
+            v8::PropertyAttribute attribute;
+
+            if (!global->Delete(context, name).FromMaybe(false) &&
+                global->GetPropertyAttributes(context, name).To(&attribute))
+            {
+                global->DefineOwnProperty(context, name.As<v8::Name>(), v8::Undefined(m_isolate), attribute).FromMaybe(false);
+            }
+        }
+    }
+
+    // and put back what it replaced or deleted
+    names = values->GetOwnPropertyNames(context, v8::ALL_PROPERTIES, v8::KeyConversionMode::kConvertToString).ToLocalChecked();
+
+    for (uint32_t i = 0; i < names->Length(); i++)
+    {
+        v8::Local<v8::Name> name = names->Get(context, i).ToLocalChecked().As<v8::Name>();
+        v8::Local<v8::Value> value = values->Get(context, name).ToLocalChecked();
+        v8::Local<v8::Value> current;
+
+        if (global->HasOwnProperty(context, name).FromMaybe(false) &&
+            global->Get(context, name).ToLocal(&current) && current->SameValue(value)) continue;
+
+        int attribute = attributes->Get(context, name).ToLocalChecked()->Int32Value(context).FromMaybe(0);
+
+        global->DefineOwnProperty(context, name, value, (v8::PropertyAttribute) attribute).FromMaybe(false);
+    }
+}
+
+CContextPtr CContextPool::Acquire(py::object global)
+{
+    v8::HandleScope handle_scope(m_isolate);
+
+    std::unique_ptr<Entry> entry;
+
+    if (m_idle.empty())
+    {
+        entry.reset(Create());
+    }
+    else
+    {
+        entry = std::move(m_idle.back());
+
+        m_idle.pop_back();
+    }
+
+    v8::Local<v8::Context> context = v8::Local<v8::Context>::New(m_isolate, entry->context);
+
+    CContextPtr ctxt(new CContext(context));
+
+    CPythonObject::BindGlobal(context, global);
+
+    ctxt->m_global = global;
+
+    m_busy.push_back(std::move(entry));
+
+    return ctxt;
+}
+
+void CContextPool::Release(CContextPtr ctxt)
+{
+    v8::HandleScope handle_scope(m_isolate);
+
+    if (!ctxt->IsEntered()) throw CJavascriptException("the context has been disposed", ::PyExc_ValueError);
+
+    v8::Local<v8::Context> context = ctxt->Handle();
+
+    if (ctxt->m_entered > 0 || (m_isolate->InContext() && m_isolate->GetCurrentContext() == context))
+    {
+        throw CJavascriptException("can't release an entered context", ::PyExc_RuntimeError);
+    }
+
+    std::vector<std::unique_ptr<Entry> >::iterator it = m_busy.begin();
+
+    while (it != m_busy.end() && (*it)->context != context) it++;
+
+    if (it == m_busy.end()) throw CJavascriptException("the context doesn't belong to this pool", ::PyExc_ValueError);
+
+    std::unique_ptr<Entry> entry(std::move(*it));
+
+    m_busy.erase(it);
+
+    // the caller must not keep running requests in a recycled context
+    ctxt->m_context.Reset();
+    ctxt->m_global = py::object();
+    ctxt->m_results.reset();
+    ctxt->m_wrappers.reset();
+
+    // the top level let/const/class bindings can't be removed, they would clash with the next request
+    bool reusable = !CContextData::Get(context)->lexical;
+
+    if (reusable) Reset(entry.get());
+
+    if (reusable && m_idle.size() < m_size)
+    {
+        m_idle.push_back(std::move(entry));
+    }
+    else
+    {
+#ifdef SUPPORT_TRACE_LIFECYCLE
+        ContextTracer::Dispose(context);
+#endif
+
+        CPythonObject::UnbindGlobal(context);
+
+        context->DetachGlobal();
+
+        {
+            v8::Context::Scope context_scope(context);
+
+            m_isolate->ContextDisposedNotification();
+        }
+
+        if (!reusable && m_idle.size() < m_size) m_idle.push_back(std::unique_ptr<Entry>(Create()));
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "Context.h"
+
+// Pool of pre-created contexts handed out per request. A released context
+// is reset before being reused: the global object gets its pristine own
+// properties back, the cached Python objects are forgotten and the Python
+// global is unbound.
+//
+// Only the own properties of the global object are restored, changes made
+// to the builtin prototypes survive a reset. The top level let/const/class
+// bindings can't be removed, so a context whose scripts may have declared
+// one is dropped and replaced by a new one instead.
+class CContextPool
+{
+    struct Entry
+    {
+        v8::Global<v8::Context> context;
+        v8::Global<v8::Value> prototype;
+        v8::Global<v8::Function> set_prototype;
+
+        // null prototype objects, own property name -> value / attributes
+        v8::Global<v8::Object> values;
+        v8::Global<v8::Object> attributes;
+    };
+
+    v8::Isolate *m_isolate;
+    size_t m_size;
+
+    std::vector<std::unique_ptr<Entry> > m_idle;
+    std::vector<std::unique_ptr<Entry> > m_busy;
+
+    Entry *Create(void);
+    void Reset(Entry *entry);
+public:
+    CContextPool(size_t size);
+
+    size_t GetSize(void) const {
+        return m_size;
+    }
+    size_t GetIdle(void) const {
+        return m_idle.size();
+    }
+    size_t GetBusy(void) const {
+        return m_busy.size();
+    }
+
+    CContextPtr Acquire(py::object global);
+    void Release(CContextPtr context);
+
+    static void Expose(void);
+};
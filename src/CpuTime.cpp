@@ -0,0 +1,90 @@
+#include <time.h>
+
+#include "CpuTime.h"
+#include "Utils.h"
+
+thread_local CCpuTimer *CCpuTimer::s_current = NULL;
+
+int64_t CCpuTimer::Now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+CCpuTimer::CCpuTimer(v8::Isolate *isolate, CContextData *data)
+    : m_isolate(isolate), m_data(data),
+      m_outer(s_current), m_running(true), m_exceeded(false)
+{
+    m_start = Now();
+
+    if (m_outer) m_outer->Charge(m_start);
+
+    s_current = this;
+
+    if (m_data && m_data->cpu_budget > 0) Arm((m_data->cpu_budget - m_data->cpu_time) / 1e9);
+}
+
+void CCpuTimer::Charge(int64_t now)
+{
+    if (m_data) m_data->cpu_time += now - m_start;
+    m_start = now;
+}
+
+bool CCpuTimer::Stop(void)
+{
+    if (!m_running) return m_exceeded;
+
+    m_running = false;
+
+    Cancel();
+
+    int64_t now = Now();
+
+    Charge(now);
+
+    s_current = m_outer;
+
+    if (m_outer) m_outer->m_start = now;
+
+    if (m_exceeded) m_isolate->CancelTerminateExecution();
+
+    return m_exceeded;
+}
+
+void CCpuTimer::Expire(void)
+{
+    // the CPU time can only be read from the thread running the context
+    m_isolate->RequestInterrupt(CheckBudget, NULL);
+}
+
+void CCpuTimer::CheckBudget(v8::Isolate *isolate, void *UNUSED_VAR(data))
+{
+    // the timer which requested the interrupt may be gone or paused by a nested one
+    for (CCpuTimer *timer = s_current; timer; timer = timer->m_outer)
+    {
+        if (timer->m_isolate == isolate) timer->Check(timer == s_current);
+    }
+}
+
+void CCpuTimer::Check(bool running)
+{
+    if (m_exceeded || !m_data || m_data->cpu_budget <= 0) return;
+
+    if (running) Charge(Now());
+
+    int64_t remaining = m_data->cpu_budget - m_data->cpu_time;
+
+    if (remaining > 0)
+    {
+        Arm(remaining / 1e9);
+    }
+    else
+    {
+        m_exceeded = true;
+
+        m_isolate->TerminateExecution();
+    }
+}
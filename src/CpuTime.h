@@ -0,0 +1,79 @@
+#pragma once
+
+#include <v8.h>
+
+#include "Exception.h"
+#include "ContextData.h"
+#include "Watchdog.h"
+
+// Charges the thread CPU time spent while alive to a context and enforces its
+// CPU budget. A nested timer pauses the enclosing one, so each context only
+// pays for its own code.
+//
+// The CPU time is only accounted once the context has data, i.e. its cpuTime
+// or cpuBudget was accessed; a timer without data just pauses the enclosing one.
+//
+// The budget is checked from an interrupt requested by the watchdog once the
+// remaining budget elapsed in wall time (the CPU time can't run faster), and
+// again as long as the budget is not spent.
+class CCpuTimer : public CWatchdog::CTimer
+{
+    static thread_local CCpuTimer *s_current;
+
+    v8::Isolate *m_isolate;
+    CContextData *m_data;
+    CCpuTimer *m_outer;
+    int64_t m_start;
+    bool m_running, m_exceeded;
+
+    void Charge(int64_t now);
+    void Check(bool running);
+
+    virtual void Expire(void) override;
+
+    static void CheckBudget(v8::Isolate *isolate, void *data);
+public:
+    CCpuTimer(v8::Isolate *isolate, CContextData *data);
+    ~CCpuTimer() {
+        Stop();
+    }
+
+    // Returns true if the budget was exceeded, the termination is then cancelled so the isolate can run again
+    bool Stop(void);
+
+    // The CPU time of the calling thread, in nanoseconds
+    static int64_t Now(void);
+
+    // Run the execution on the budget of the context, raising JSTimeoutError once it is spent
+    template <typename Func>
+    static py::object Run(v8::Handle<v8::Context> ctxt, Func func)
+    {
+        CContextData *data = CContextData::Find(ctxt);
+
+        if (!data && !s_current) return func();
+
+        if (data && data->cpu_budget > 0 && data->cpu_time >= data->cpu_budget)
+            throw CJavascriptException("CPU time budget exceeded", CJavascriptException::s_timeout_error);
+
+        CCpuTimer timer(ctxt->GetIsolate(), data);
+
+        py::object result;
+
+        try
+        {
+            result = func();
+        }
+        catch (...)
+        {
+            if (!timer.Stop()) throw;
+
+            ::PyErr_Clear();
+
+            throw CJavascriptException("CPU time budget exceeded", CJavascriptException::s_timeout_error);
+        }
+
+        if (timer.Stop()) throw CJavascriptException("CPU time budget exceeded", CJavascriptException::s_timeout_error);
+
+        return result;
+    }
+};
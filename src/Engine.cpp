@@ -1,8 +1,14 @@
 #include "Engine.h"
 #include "Exception.h"
 #include "Wrapper.h"
+#include "Platform.h"
+#include "Pressure.h"
+#include "Watchdog.h"
+#include "CpuTime.h"
 
+#include <cstring>
 #include <iostream>
+#include <vector>
 
 #include <boost/preprocessor.hpp>
 #include <boost/thread/mutex.hpp>
@@ -10,6 +16,12 @@
 
 void CEngine::Expose(void)
 {
+    py::enum_<v8::MemoryPressureLevel>("JSMemoryPressureLevel")
+    .value("Normal", v8::MemoryPressureLevel::kNone)
+    .value("Moderate", v8::MemoryPressureLevel::kModerate)
+    .value("Critical", v8::MemoryPressureLevel::kCritical)
+    ;
+
     py::class_<CEngine, boost::noncopyable>("JSEngine", "JSEngine is a backend Javascript engine.")
     .def(py::init<>("Create a new script engine instance."))
     .add_static_property("version", &CEngine::GetVersion,
@@ -31,10 +43,32 @@ void CEngine::Expose(void)
          "it cannot be reinitialized.")
     .staticmethod("dispose")
 
-    .def("lowMemory", &v8::Isolate::LowMemoryNotification,
-         "Optional notification that the system is running low on memory.")
+    .def("lowMemory", &CEngine::LowMemory,
+         "Optional notification that the system is running low on memory, "
+         "collects all the available garbage of the current isolate.")
     .staticmethod("lowMemory")
 
+    .def("watchMemoryPressure", &CMemoryPressureWatcher::Start, (py::arg("path") = std::string(),
+                                                                  py::arg("interval") = 100,
+                                                                  py::arg("moderate") = 0.8,
+                                                                  py::arg("critical") = 0.95),
+         "Starts a thread watching the cgroup v2 memory controller (the cgroup of the process by default) "
+         "every interval milliseconds, and notifies all the isolates when the memory usage crosses "
+         "the moderate or critical share of the cgroup limit, or the cgroup stalls on memory. "
+         "Returns false if no cgroup v2 memory controller is available.")
+    .staticmethod("watchMemoryPressure")
+
+    .def("unwatchMemoryPressure", &CMemoryPressureWatcher::Stop,
+         "Stops the memory pressure watcher.")
+    .staticmethod("unwatchMemoryPressure")
+
+    .add_static_property("memoryPressure", &CMemoryPressureWatcher::GetLevel,
+                         "The memory pressure level last forwarded by the watcher.")
+
+    .add_static_property("wrapperStats", &CEngine::GetWrapperStats,
+                         "Allocation counters of the Javascript object wrappers "
+                         "(allocated, freed and reused from the per-thread pools).")
+
     /*
         .def("setMemoryLimit", &CEngine::SetMemoryLimit, (py::arg("max_young_space_size") = 0,
                                                           py::arg("max_old_space_size") = 0,
@@ -73,7 +107,9 @@ void CEngine::Expose(void)
     py::class_<CScript, boost::noncopyable>("JSScript", "JSScript is a compiled JavaScript script.", py::no_init)
     .add_property("source", &CScript::GetSource, "the source code")
 
-    .def("run", &CScript::Run, "Execute the compiled code.")
+    .def("run", &CScript::Run, (py::arg("timeout") = 0),
+         "Execute the compiled code. "
+         "A positive timeout (in seconds) terminates the execution and raises JSTimeoutError once it expires.")
     ;
 
     py::objects::class_value_wrapper<std::shared_ptr<CScript>,
@@ -86,6 +122,26 @@ bool CEngine::IsDead(void)
     return v8::Isolate::GetCurrent()->IsDead();
 }
 
+py::dict CEngine::GetWrapperStats(void)
+{
+    py::dict stats;
+
+    stats["allocated"] = CPoolStats::allocated.load();
+    stats["freed"] = CPoolStats::freed.load();
+    stats["reused"] = CPoolStats::reused.load();
+
+    return stats;
+}
+
+void CEngine::LowMemory(void)
+{
+    v8::Isolate *isolate = v8::Isolate::GetCurrent();
+
+    isolate->LowMemoryNotification();
+
+    CPlatform::PumpMessageLoop(isolate);
+}
+
 void CEngine::TerminateAllThreads(void)
 {
     v8::Isolate::GetCurrent()->TerminateExecution();
@@ -147,48 +203,346 @@ std::shared_ptr<CScript> CEngine::InternalCompile(v8::Handle<v8::String> src,
 {
     v8::Isolate* isolate = v8::Isolate::GetCurrent();
     v8::HandleScope handle_scope(isolate);
-    v8::Local<v8::Context> context = isolate->GetCurrentContext();
 
     v8::TryCatch try_catch(isolate);
 
     v8::Persistent<v8::String> script_source(m_isolate, src);
 
+    v8::MaybeLocal<v8::Script> script = CompileScript(v8::Local<v8::String>::New(m_isolate, script_source), name, line, col);
+
+    if (script.IsEmpty()) CJavascriptException::ThrowIf(m_isolate, try_catch);
+
+    return std::shared_ptr<CScript>(new CScript(m_isolate, *this, script_source, script.ToLocalChecked()));
+}
+
+// Looks for the top level let/const/class declarations of a script, whose bindings outlive
+// it in the global lexical scope. Strings, comments, template literals, regular expressions,
+// member names and anything nested in brackets are skipped. A source it can't follow, such
+// as unbalanced brackets, counts as declaring.
+class CLexicalScanner
+{
+    enum State { kCode, kLineComment, kBlockComment, kString, kTemplate, kRegExp };
+
+    State m_state;
+    uint16_t m_quote, m_last;
+    bool m_escaped, m_slash, m_dollar, m_in_class;
+
+    int m_depth;
+    std::vector<int> m_substitutions; // the depths the ${ of the template literals opened
+
+    char m_word[12];
+    size_t m_word_len;
+    bool m_word_member, m_member, m_operand, m_found;
+
+    static bool IsWordChar(uint16_t c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+               c == '_' || c == '$' || c == '\\' || c > 0x7f;
+    }
+
+    bool IsWord(const char *word) const
+    {
+        return m_word_len == strlen(word) && strncmp(m_word, word, m_word_len) == 0;
+    }
+
+    void EndWord(void)
+    {
+        if (m_word_len == 0) return;
+
+        if (m_depth == 0 && !m_word_member && (IsWord("let") || IsWord("const") || IsWord("class"))) m_found = true;
+
+        // a slash after these keywords starts a regular expression, not a division
+        static const char *operators[] = {
+            "return", "typeof", "instanceof", "in", "of", "new", "delete", "void",
+            "throw", "case", "do", "else", "yield", "await"
+        };
+
+        m_operand = true;
+
+        for (size_t i = 0; i < _countof(operators) && m_operand; i++) m_operand = !IsWord(operators[i]);
+
+        m_word_len = 0;
+        m_member = false;
+    }
+
+    void Code(uint16_t c)
+    {
+        if (m_slash)
+        {
+            m_slash = false;
+
+            if (c == '/') { m_state = kLineComment; return; }
+            if (c == '*') { m_state = kBlockComment; m_last = 0; return; }
+
+            if (!m_operand)
+            {
+                m_state = kRegExp;
+                m_escaped = m_in_class = false;
+
+                RegExp(c);
+
+                return;
+            }
+
+            m_operand = m_member = false;
+        }
+
+        if (IsWordChar(c))
+        {
+            if (m_word_len == 0) m_word_member = m_member;
+
+            // no keyword is that long, the word only has to stay different from them
+            if (m_word_len < sizeof(m_word)) m_word[m_word_len++] = (char) c;
+
+            return;
+        }
+
+        EndWord();
+
+        switch (c)
+        {
+        case ' ': case '\t': case '\r': case '\n': case '\v': case '\f':
+            break;
+        case '\'': case '"':
+            m_state = kString;
+            m_quote = c;
+            m_escaped = false;
+            break;
+        case '`':
+            m_state = kTemplate;
+            m_escaped = m_dollar = false;
+            break;
+        case '/':
+            m_slash = true;
+            break;
+        case '.':
+            m_member = true;
+            m_operand = false;
+            break;
+        case '(': case '[': case '{':
+            m_depth++;
+            m_operand = m_member = false;
+            break;
+        case '}':
+            if (!m_substitutions.empty() && m_depth == m_substitutions.back() + 1)
+            {
+                m_depth = m_substitutions.back();
+                m_substitutions.pop_back();
+
+                m_state = kTemplate;
+                m_escaped = m_dollar = false;
+
+                break;
+            }
+            // fall through
+        case ')': case ']':
+            if (--m_depth < 0) m_found = true;
+
+            m_operand = true;
+            m_member = false;
+            break;
+        default:
+            m_operand = m_member = false;
+            break;
+        }
+    }
+
+    void RegExp(uint16_t c)
+    {
+        if (m_escaped)
+            m_escaped = false;
+        else if (c == '\\')
+            m_escaped = true;
+        else if (c == '[')
+            m_in_class = true;
+        else if (c == ']')
+            m_in_class = false;
+        else if ((c == '/' && !m_in_class) || c == '\n')
+        {
+            // a regular expression can't span lines, a misread division resumes on the next one
+            m_state = kCode;
+            m_operand = true;
+        }
+    }
+public:
+    CLexicalScanner()
+        : m_state(kCode), m_quote(0), m_last(0), m_escaped(false), m_slash(false), m_dollar(false), m_in_class(false),
+          m_depth(0), m_word_len(0), m_word_member(false), m_member(false), m_operand(false), m_found(false)
+    {
+    }
+
+    bool Found(void) const {
+        return m_found;
+    }
+
+    void Feed(uint16_t c)
+    {
+        switch (m_state)
+        {
+        case kCode:
+            Code(c);
+            break;
+        case kLineComment:
+            if (c == '\n' || c == '\r' || c == 0x2028 || c == 0x2029) m_state = kCode;
+            break;
+        case kBlockComment:
+            if (m_last == '*' && c == '/') m_state = kCode;
+            m_last = c;
+            break;
+        case kString:
+            if (m_escaped)
+                m_escaped = false;
+            else if (c == '\\')
+                m_escaped = true;
+            else if (c == m_quote || c == '\n')
+            {
+                m_state = kCode;
+                m_operand = true;
+            }
+            break;
+        case kTemplate:
+            if (m_escaped)
+            {
+                m_escaped = m_dollar = false;
+                break;
+            }
+
+            if (c == '\\')
+                m_escaped = true;
+            else if (c == '`')
+            {
+                m_state = kCode;
+                m_operand = true;
+            }
+            else if (m_dollar && c == '{')
+            {
+                m_substitutions.push_back(m_depth++);
+
+                m_state = kCode;
+                m_operand = m_member = false;
+            }
+
+            m_dollar = c == '$';
+            break;
+        case kRegExp:
+            RegExp(c);
+            break;
+        }
+    }
+
+    bool End(void)
+    {
+        if (m_state == kCode) EndWord();
+
+        return m_found || m_depth != 0;
+    }
+};
+
+// Whether the source may declare a top level let/const/class binding, read straight from
+// the V8 string in chunks and stopped at the first declaration.
+static bool MayDeclareLexical(v8::Isolate *isolate, v8::Handle<v8::String> src)
+{
+    CLexicalScanner scanner;
+
+    uint16_t buffer[1024];
+
+    for (int start = 0, length = src->Length(); start < length && !scanner.Found(); start += _countof(buffer))
+    {
+        int count = src->Write(isolate, buffer, start, _countof(buffer), v8::String::NO_NULL_TERMINATION);
+
+        for (int i = 0; i < count && !scanner.Found(); i++) scanner.Feed(buffer[i]);
+    }
+
+    return scanner.End();
+}
+
+v8::MaybeLocal<v8::Script> CEngine::CompileScript(v8::Handle<v8::String> src,
+        v8::Handle<v8::Value> name,
+        int line, int col)
+{
+    v8::Local<v8::Context> context = m_isolate->GetCurrentContext();
+
+    CContextStats *stats = CContextStats::Get(context);
+    CContextData *data = CContextData::Find(context);
+
+    // a pool recreates the context instead of reusing it with the bindings of the request
+    if (data && data->pooled && !data->lexical) data->lexical = MayDeclareLexical(m_isolate, src);
+
     v8::MaybeLocal<v8::Script> script;
-    v8::Handle<v8::String> source = v8::Local<v8::String>::New(m_isolate, script_source);
+
+    CStatsTimer timer(stats ? &stats->compile_time : NULL);
 
     Py_BEGIN_ALLOW_THREADS
 
     if (line >= 0 && col >= 0)
     {
         v8::ScriptOrigin script_origin(name, v8::Integer::New(m_isolate, line), v8::Integer::New(m_isolate, col));
-        script = v8::Script::Compile(context, source, &script_origin);
+        script = v8::Script::Compile(context, src, &script_origin);
     }
     else
     {
         v8::ScriptOrigin script_origin(name);
-        script = v8::Script::Compile(context, source, &script_origin);
+        script = v8::Script::Compile(context, src, &script_origin);
     }
 
     Py_END_ALLOW_THREADS
 
+    if (stats && script.IsEmpty()) stats->exceptions++;
+
+    return script;
+}
+
+py::object CEngine::Evaluate(v8::Handle<v8::String> src,
+                             v8::Handle<v8::Value> name,
+                             int line, int col)
+{
+    v8::HandleScope handle_scope(m_isolate);
+
+    v8::TryCatch try_catch(m_isolate);
+
+    v8::MaybeLocal<v8::Script> script = CompileScript(src, name, line, col);
+
     if (script.IsEmpty()) CJavascriptException::ThrowIf(m_isolate, try_catch);
 
-    return std::shared_ptr<CScript>(new CScript(m_isolate, *this, script_source, script.ToLocalChecked()));
+    return ExecuteScript(script.ToLocalChecked());
 }
 
 py::object CEngine::ExecuteScript(v8::Handle<v8::Script> script)
+{
+    v8::HandleScope handle_scope(m_isolate);
+
+    CMessageLoopScope message_loop(m_isolate);
+
+    return CCpuTimer::Run(m_isolate->GetCurrentContext(), [&]() {
+        return RunScript(script);
+    });
+}
+
+py::object CEngine::RunScript(v8::Handle<v8::Script> script)
 {
     v8::Isolate* isolate = v8::Isolate::GetCurrent();
     v8::HandleScope handle_scope(isolate);
     v8::Local<v8::Context> context = isolate->GetCurrentContext();
 
+    CContextStats *stats = CContextStats::Get(context);
+
+    if (stats) stats->evals++;
+
     v8::TryCatch try_catch(isolate);
 
     v8::MaybeLocal<v8::Value> result;
 
     Py_BEGIN_ALLOW_THREADS
 
-    result = script->Run(context);
+    {
+        CStatsTimer timer(stats ? &stats->run_time : NULL);
+
+        // with the scoped policy, the microtasks run when the outermost execution is over
+        v8::MicrotasksScope microtasks_scope(isolate, CContextData::GetMicrotaskQueue(context),
+                                             v8::MicrotasksScope::kRunMicrotasks);
+
+        result = script->Run(context);
+    }
 
     Py_END_ALLOW_THREADS
 
@@ -196,6 +550,8 @@ py::object CEngine::ExecuteScript(v8::Handle<v8::Script> script)
     {
         if (try_catch.HasCaught())
         {
+            if (stats) stats->exceptions++;
+
             if(!try_catch.CanContinue() && PyErr_OCCURRED())
             {
                 throw py::error_already_set();
@@ -219,9 +575,11 @@ const std::string CScript::GetSource(void) const
     return std::string(*source, source.length());
 }
 
-py::object CScript::Run(void)
+py::object CScript::Run(double timeout)
 {
     v8::HandleScope handle_scope(m_isolate);
 
-    return m_engine.ExecuteScript(Script());
+    return CWatchdog::Run(m_isolate, timeout, [&]() {
+        return m_engine.ExecuteScript(Script());
+    });
 }
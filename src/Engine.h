@@ -19,6 +19,11 @@ class CEngine
 protected:
     CScriptPtr InternalCompile(v8::Handle<v8::String> src, v8::Handle<v8::Value> name, int line, int col);
 
+    py::object RunScript(v8::Handle<v8::Script> script);
+
+    // Compile in the current context and handle scope, releasing the GIL meanwhile
+    v8::MaybeLocal<v8::Script> CompileScript(v8::Handle<v8::String> src, v8::Handle<v8::Value> name, int line, int col);
+
     static void TerminateAllThreads(void);
 
     static void ReportFatalError(const char* location, const char* message);
@@ -54,6 +59,9 @@ public:
 
     py::object ExecuteScript(v8::Handle<v8::Script> script);
 
+    // Compile and run without keeping the script, for the one-shot evaluations
+    py::object Evaluate(v8::Handle<v8::String> src, v8::Handle<v8::Value> name, int line, int col);
+
     static void SetFlags(const std::string& flags) {
         v8::V8::SetFlagsFromString(flags.c_str(), flags.size());
     }
@@ -64,6 +72,9 @@ public:
     static py::object Serialize(void);
     static void Deserialize(py::object snapshot);
     static bool IsDead(void);
+    static void LowMemory(void);
+
+    static py::dict GetWrapperStats(void);
 };
 
 class CScript
@@ -104,5 +115,5 @@ public:
 
     const std::string GetSource(void) const;
 
-    py::object Run(void);
+    py::object Run(double timeout = 0);
 };
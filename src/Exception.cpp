@@ -15,6 +15,8 @@ std::ostream& operator <<(std::ostream& os, const CJavascriptStackTrace& obj)
     return os;
 }
 
+PyObject *CJavascriptException::s_timeout_error = NULL;
+
 void CJavascriptException::Expose(void)
 {
     py::class_<CJavascriptStackTrace>("JSStackTrace", py::no_init)
@@ -69,6 +71,12 @@ void CJavascriptException::Expose(void)
     .add_property("stackTrace", &CJavascriptException::GetStackTrace, "The stack trace of error statement.")
     .def("print_tb", &CJavascriptException::PrintCallStack, (py::arg("file") = py::object()), "Print the stack trace of error statement.");
 
+    s_timeout_error = ::PyErr_NewException("_STPyV8.JSTimeoutError", ::PyExc_TimeoutError, NULL);
+
+    if (!s_timeout_error) py::throw_error_already_set();
+
+    py::scope().attr("JSTimeoutError") = py::object(py::handle<>(py::borrowed(s_timeout_error)));
+
     py::register_exception_translator<CJavascriptException>(ExceptionTranslator::Translate);
 
     py::converter::registry::push_back(ExceptionTranslator::Convertible,
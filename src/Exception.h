@@ -213,6 +213,9 @@ public:
 
     static void ThrowIf(v8::Isolate *isolate, v8::TryCatch& try_catch);
 
+    // JSTimeoutError, the TimeoutError subclass raised when a deadline or a CPU budget expires
+    static PyObject *s_timeout_error;
+
     static void Expose(void);
 };
 
@@ -0,0 +1,142 @@
+#include "GCStats.h"
+#include "Platform.h"
+#include "Utils.h"
+
+#include "libplatform/libplatform.h"
+
+CGCStats::CGCStats()
+    : m_heap_before(0), m_heap_after(0), m_pending_first(0), m_pending_count(0), m_drain_posted(false), m_listener(NULL)
+{
+    for (size_t i = 0; i < kKinds; i++)
+    {
+        m_kinds[i].count = 0;
+        m_kinds[i].total_us = 0;
+        m_kinds[i].max_us = 0;
+
+        for (size_t j = 0; j < kBuckets; j++) m_kinds[i].buckets[j] = 0;
+
+        m_start[i] = 0;
+        m_used[i] = 0;
+    }
+}
+
+const char *CGCStats::KindName(size_t kind)
+{
+    static const char *names[kKinds] = {
+        "scavenge", "minorMarkCompact", "markSweepCompact", "incrementalMarking", "processWeakCallbacks"
+    };
+
+    return kind < kKinds ? names[kind] : "unknown";
+}
+
+size_t CGCStats::KindOf(v8::GCType type)
+{
+    size_t kind = 0;
+
+    for (uint32_t bits = type; bits > 1; bits >>= 1) kind++;
+
+    return kind < kKinds ? kind : kKinds - 1;
+}
+
+size_t CGCStats::UsedHeapSize(v8::Isolate *isolate)
+{
+    v8::HeapStatistics stats;
+
+    isolate->GetHeapStatistics(&stats);
+
+    return stats.used_heap_size();
+}
+
+void CGCStats::Prologue(v8::Isolate *isolate, v8::GCType type, v8::GCCallbackFlags UNUSED_VAR(flags), void *data)
+{
+    CGCStats *stats = static_cast<CGCStats *>(data);
+    size_t kind = KindOf(type);
+
+    stats->m_used[kind] = UsedHeapSize(isolate);
+    stats->m_start[kind] = CPlatform::GetPlatform()->MonotonicallyIncreasingTime();
+}
+
+void CGCStats::Epilogue(v8::Isolate *isolate, v8::GCType type, v8::GCCallbackFlags UNUSED_VAR(flags), void *data)
+{
+    CGCStats *stats = static_cast<CGCStats *>(data);
+    size_t kind = KindOf(type);
+
+    double pause = CPlatform::GetPlatform()->MonotonicallyIncreasingTime() - stats->m_start[kind];
+    uint64_t pause_us = pause > 0 ? (uint64_t)(pause * 1000000) : 0;
+
+    Kind& k = stats->m_kinds[kind];
+
+    k.count.fetch_add(1, std::memory_order_relaxed);
+    k.total_us.fetch_add(pause_us, std::memory_order_relaxed);
+
+    uint64_t max_us = k.max_us.load(std::memory_order_relaxed);
+
+    while (max_us < pause_us && !k.max_us.compare_exchange_weak(max_us, pause_us, std::memory_order_relaxed));
+
+    size_t bucket = 0;
+
+    for (uint64_t us = pause_us; us && bucket < kBuckets - 1; us >>= 1) bucket++;
+
+    k.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+
+    Event event = { type, pause * 1000, stats->m_used[kind], UsedHeapSize(isolate) };
+
+    stats->m_heap_before.store(event.heap_before, std::memory_order_relaxed);
+    stats->m_heap_after.store(event.heap_after, std::memory_order_relaxed);
+
+    Listener listener = stats->m_listener.load();
+
+    if (!listener) return;
+
+    if (stats->m_pending_count == kPendingEvents)
+    {
+        stats->m_pending_first = (stats->m_pending_first + 1) % kPendingEvents;
+        stats->m_pending_count--;
+    }
+
+    stats->m_pending[(stats->m_pending_first + stats->m_pending_count) % kPendingEvents] = event;
+    stats->m_pending_count++;
+
+    if (!stats->m_drain_posted)
+    {
+        stats->m_drain_posted = true;
+
+        listener(isolate);
+    }
+}
+
+void CGCStats::SetListener(Listener listener)
+{
+    m_listener = listener;
+
+    if (!listener) m_pending_count = 0;
+}
+
+bool CGCStats::PopEvent(Event& event)
+{
+    if (m_pending_count == 0)
+    {
+        m_drain_posted = false;
+
+        return false;
+    }
+
+    event = m_pending[m_pending_first];
+
+    m_pending_first = (m_pending_first + 1) % kPendingEvents;
+    m_pending_count--;
+
+    return true;
+}
+
+void CGCStats::Attach(v8::Isolate *isolate)
+{
+    isolate->AddGCPrologueCallback(Prologue, this);
+    isolate->AddGCEpilogueCallback(Epilogue, this);
+}
+
+void CGCStats::Detach(v8::Isolate *isolate)
+{
+    isolate->RemoveGCPrologueCallback(Prologue, this);
+    isolate->RemoveGCEpilogueCallback(Epilogue, this);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include <v8.h>
+
+// Per-isolate GC pause accounting, fed by the GC prologue/epilogue callbacks
+// on the isolate thread and read lock-free from any thread.
+class CGCStats
+{
+public:
+    // scavenge, minor mark-compact, mark-sweep-compact, incremental marking, weak callbacks
+    static const size_t kKinds = 5;
+
+    // bucket i counts the pauses in [2^(i-1), 2^i) microseconds, the last one is open-ended
+    static const size_t kBuckets = 24;
+
+    struct Kind
+    {
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> total_us;
+        std::atomic<uint64_t> max_us;
+        std::atomic<uint64_t> buckets[kBuckets];
+    };
+
+    // a finished pause, as passed to the event listener
+    struct Event
+    {
+        v8::GCType type;
+        double pause_ms;
+        size_t heap_before;
+        size_t heap_after;
+    };
+
+    typedef void (*Listener)(v8::Isolate *isolate);
+
+    // the events waiting to be drained, the oldest ones are dropped once it is full
+    static const size_t kPendingEvents = 64;
+private:
+    Kind m_kinds[kKinds];
+
+    std::atomic<size_t> m_heap_before;
+    std::atomic<size_t> m_heap_after;
+
+    // the pauses in progress, only touched by the isolate thread
+    double m_start[kKinds];
+    size_t m_used[kKinds];
+
+    // the finished pauses waiting for the listener, only touched by the isolate thread
+    Event m_pending[kPendingEvents];
+    size_t m_pending_first, m_pending_count;
+    bool m_drain_posted;
+
+    std::atomic<Listener> m_listener;
+
+    static size_t UsedHeapSize(v8::Isolate *isolate);
+
+    static void Prologue(v8::Isolate *isolate, v8::GCType type, v8::GCCallbackFlags flags, void *data);
+    static void Epilogue(v8::Isolate *isolate, v8::GCType type, v8::GCCallbackFlags flags, void *data);
+public:
+    CGCStats();
+
+    static size_t KindOf(v8::GCType type);
+    static const char *KindName(size_t kind);
+
+    const Kind& GetKind(size_t kind) const {
+        return m_kinds[kind];
+    }
+    size_t GetHeapBefore(void) const {
+        return m_heap_before;
+    }
+    size_t GetHeapAfter(void) const {
+        return m_heap_after;
+    }
+
+    // Called on the isolate thread, still inside the GC, when a pause is queued and no drain
+    // is pending; the events are then drained with PopEvent outside of the GC
+    void SetListener(Listener listener);
+
+    // Pops the oldest queued event, returns false (and allows the next drain) once none is left
+    bool PopEvent(Event& event);
+
+    void Attach(v8::Isolate *isolate);
+    void Detach(v8::Isolate *isolate);
+};
@@ -0,0 +1,165 @@
+#include "HeapTuner.h"
+#include "Isolate.h"
+#include "Platform.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include "libplatform/libplatform.h"
+
+// major GCs closer than this are considered frequent
+static const double kFrequentInterval = 1.0;
+// major GCs further apart than this are considered rare
+static const double kRareInterval = 10.0;
+// fraction of the heap surviving a major GC considered high
+static const double kHighSurvival = 0.7;
+
+class CHeapTunerTask : public v8::Task
+{
+    v8::Isolate *m_isolate;
+public:
+    CHeapTunerTask(v8::Isolate *isolate) : m_isolate(isolate)
+    {
+    }
+
+    virtual void Run(void) override
+    {
+        // the tuner may have been stopped since the task was posted
+        CHeapTuner *tuner = CIsolateData::Get(m_isolate)->heap_tuner.get();
+
+        if (tuner) tuner->Shrink();
+    }
+};
+
+static double Now(void)
+{
+    return CPlatform::GetPlatform()->MonotonicallyIncreasingTime();
+}
+
+CHeapTuner::CHeapTuner(v8::Isolate *isolate, size_t min_size, size_t max_size)
+    : m_isolate(isolate), m_min(min_size), m_max(max_size), m_limit(min_size), m_used(0),
+      m_last_gc(Now()), m_interval(0), m_survival(0), m_shrinking(false)
+{
+    // removing the callback is the only way to lower the limit, start from the minimum
+    m_isolate->AddNearHeapLimitCallback(NearHeapLimit, this);
+    m_isolate->RemoveNearHeapLimitCallback(NearHeapLimit, m_min);
+    m_isolate->AddNearHeapLimitCallback(NearHeapLimit, this);
+
+    m_isolate->AddGCPrologueCallback(Prologue, this, v8::kGCTypeMarkSweepCompact);
+    m_isolate->AddGCEpilogueCallback(Epilogue, this, v8::kGCTypeMarkSweepCompact);
+
+    Log("start", 0, m_min, "tuning between the minimum and the maximum size");
+}
+
+CHeapTuner::~CHeapTuner()
+{
+    m_isolate->RemoveGCPrologueCallback(Prologue, this);
+    m_isolate->RemoveGCEpilogueCallback(Epilogue, this);
+    m_isolate->RemoveNearHeapLimitCallback(NearHeapLimit, 0);
+}
+
+void CHeapTuner::Log(const std::string& action, size_t old_limit, size_t new_limit, const std::string& reason)
+{
+    Decision decision = { Now(), action, old_limit, new_limit, reason };
+
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    m_decisions.push_back(decision);
+
+    if (m_decisions.size() > kMaxDecisions) m_decisions.pop_front();
+}
+
+std::deque<CHeapTuner::Decision> CHeapTuner::GetDecisions(void) const
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    return m_decisions;
+}
+
+size_t CHeapTuner::UsedHeapSize(v8::Isolate *isolate)
+{
+    v8::HeapStatistics stats;
+
+    isolate->GetHeapStatistics(&stats);
+
+    return stats.used_heap_size();
+}
+
+size_t CHeapTuner::NearHeapLimit(void *data, size_t current_heap_limit, size_t UNUSED_VAR(initial_heap_limit))
+{
+    CHeapTuner *tuner = static_cast<CHeapTuner *>(data);
+
+    if (current_heap_limit >= tuner->m_max)
+    {
+        tuner->Log("limit", current_heap_limit, current_heap_limit, "the maximum size is reached");
+
+        return current_heap_limit;
+    }
+
+    bool pressure = tuner->m_interval < kFrequentInterval && tuner->m_survival > kHighSurvival;
+
+    size_t limit = pressure ? current_heap_limit * 2 : current_heap_limit + current_heap_limit / 2;
+
+    if (limit > tuner->m_max) limit = tuner->m_max;
+
+    std::ostringstream reason;
+
+    reason << "near the heap limit, major GC every " << tuner->m_interval << "s, "
+           << (int)(tuner->m_survival * 100) << "% surviving";
+
+    tuner->Log("grow", current_heap_limit, limit, reason.str());
+
+    tuner->m_limit = limit;
+
+    return limit;
+}
+
+void CHeapTuner::Prologue(v8::Isolate *isolate, v8::GCType UNUSED_VAR(type), v8::GCCallbackFlags UNUSED_VAR(flags), void *data)
+{
+    static_cast<CHeapTuner *>(data)->m_used = UsedHeapSize(isolate);
+}
+
+void CHeapTuner::Epilogue(v8::Isolate *isolate, v8::GCType UNUSED_VAR(type), v8::GCCallbackFlags UNUSED_VAR(flags), void *data)
+{
+    CHeapTuner *tuner = static_cast<CHeapTuner *>(data);
+
+    size_t used = UsedHeapSize(isolate);
+    double now = Now();
+
+    tuner->m_interval = now - tuner->m_last_gc;
+    tuner->m_last_gc = now;
+    tuner->m_survival = tuner->m_used ? (double) used / tuner->m_used : 0;
+
+    if (tuner->m_shrinking || tuner->m_limit <= tuner->m_min) return;
+
+    if (tuner->m_interval > kRareInterval && used * 4 < tuner->m_limit)
+    {
+        // the limit can't be changed from inside the GC
+        tuner->m_shrinking = true;
+
+        CPlatform::GetPlatform()->GetForegroundTaskRunner(isolate)->PostTask(
+            std::unique_ptr<v8::Task>(new CHeapTunerTask(isolate)));
+    }
+}
+
+void CHeapTuner::Shrink(void)
+{
+    m_shrinking = false;
+
+    size_t used = UsedHeapSize(m_isolate);
+    size_t limit = std::max(m_min, used * 2);
+
+    if (limit >= m_limit) return;
+
+    std::ostringstream reason;
+
+    reason << "major GC every " << m_interval << "s, " << used << " bytes live";
+
+    m_isolate->RemoveNearHeapLimitCallback(NearHeapLimit, limit);
+    m_isolate->AddNearHeapLimitCallback(NearHeapLimit, this);
+
+    Log("shrink", m_limit, limit, reason.str());
+
+    m_limit = limit;
+}
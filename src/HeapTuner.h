@@ -0,0 +1,65 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <string>
+
+#include <v8.h>
+
+// Optional per-isolate tuner moving the old generation limit between a
+// minimum and a maximum. The limit starts at the minimum and grows through
+// the NearHeapLimitCallback, faster when the major GCs come in quick
+// succession and most of the heap survives them; it is lowered again when
+// the major GCs get rare and the live heap is small compared to the limit.
+class CHeapTuner
+{
+public:
+    struct Decision
+    {
+        double time;
+        std::string action;
+        size_t old_limit;
+        size_t new_limit;
+        std::string reason;
+    };
+private:
+    // decisions kept in the event log
+    static const size_t kMaxDecisions = 256;
+
+    v8::Isolate *m_isolate;
+    size_t m_min, m_max;
+
+    // only touched by the isolate thread
+    size_t m_limit;
+    size_t m_used;
+    double m_last_gc;
+    double m_interval;
+    double m_survival;
+    bool m_shrinking;
+
+    mutable std::mutex m_lock;
+    std::deque<Decision> m_decisions;
+
+    void Log(const std::string& action, size_t old_limit, size_t new_limit, const std::string& reason);
+
+    static size_t UsedHeapSize(v8::Isolate *isolate);
+
+    static size_t NearHeapLimit(void *data, size_t current_heap_limit, size_t initial_heap_limit);
+    static void Prologue(v8::Isolate *isolate, v8::GCType type, v8::GCCallbackFlags flags, void *data);
+    static void Epilogue(v8::Isolate *isolate, v8::GCType type, v8::GCCallbackFlags flags, void *data);
+public:
+    CHeapTuner(v8::Isolate *isolate, size_t min_size, size_t max_size);
+    ~CHeapTuner();
+
+    size_t GetMinSize(void) const {
+        return m_min;
+    }
+    size_t GetMaxSize(void) const {
+        return m_max;
+    }
+
+    std::deque<Decision> GetDecisions(void) const;
+
+    // Lower the limit after rare major GCs, run from a foreground task outside of the GC
+    void Shrink(void);
+};
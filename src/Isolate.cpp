@@ -3,15 +3,142 @@
 #include "Wrapper.h"
 #include "Engine.h"
 
+#include "Pressure.h"
+
 #include "libplatform/libplatform.h"
+#include <v8-profiler.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Writes the serialized heap snapshot straight to a file descriptor, chunk by chunk
+class CFileOutputStream : public v8::OutputStream
+{
+    int m_fd;
+    int m_errno;
+public:
+    CFileOutputStream(int fd) : m_fd(fd), m_errno(0)
+    {
+    }
+
+    int GetErrno(void) const {
+        return m_errno;
+    }
+
+    virtual int GetChunkSize(void) override
+    {
+        return 64 * 1024;
+    }
+
+    virtual void EndOfStream(void) override
+    {
+    }
+
+    virtual WriteResult WriteAsciiChunk(char *data, int size) override
+    {
+        while (size > 0)
+        {
+            ssize_t written = ::write(m_fd, data, size);
+
+            if (written < 0)
+            {
+                if (errno == EINTR) continue;
+
+                m_errno = errno;
+
+                return kAbort;
+            }
+
+            data += written;
+            size -= written;
+        }
+
+        return kContinue;
+    }
+};
+
+// Deletes a heap snapshot however the scope is left
+struct CHeapSnapshotDeleter
+{
+    void operator()(const v8::HeapSnapshot *snapshot) const
+    {
+        const_cast<v8::HeapSnapshot *>(snapshot)->Delete();
+    }
+};
+
+// Stops the sampling heap profiler however the scope is left
+class CSamplingHeapProfilerScope
+{
+    v8::HeapProfiler *m_profiler;
+public:
+    CSamplingHeapProfilerScope(v8::HeapProfiler *profiler) : m_profiler(profiler)
+    {
+    }
+    ~CSamplingHeapProfilerScope()
+    {
+        m_profiler->StopSamplingHeapProfiler();
+    }
+};
+
+// Passes the queued GC events to the Python callback, a GC it triggers queues to the same drain
+class CGCEventTask : public v8::Task
+{
+    v8::Isolate *m_isolate;
+public:
+    CGCEventTask(v8::Isolate *isolate) : m_isolate(isolate)
+    {
+    }
+
+    virtual void Run(void) override
+    {
+        CPythonGIL python_gil;
+
+        CIsolateData *data = CIsolateData::Get(m_isolate);
+
+        if (!data) return;
+
+        CGCStats::Event event;
+
+        while (data->gc.PopEvent(event))
+        {
+            py::object callback = data->gc_callback;
+
+            if (callback.is_none()) continue;
+
+            try
+            {
+                callback(CGCStats::KindName(CGCStats::KindOf(event.type)), event.pause_ms,
+                         event.heap_before, event.heap_after);
+            }
+            catch (const py::error_already_set&)
+            {
+                ::PyErr_Print();
+            }
+        }
+    }
+};
+
+static void PostGCEvents(v8::Isolate *isolate)
+{
+    // the GC is still running, the events wait for the next pump of the message loop
+    CPlatform::GetPlatform()->GetForegroundTaskRunner(isolate)->PostTask(
+        std::unique_ptr<v8::Task>(new CGCEventTask(isolate)));
+}
 
 void CIsolate::Init(bool owner)
 {
     m_owner = owner;
+    m_created = true;
 
     v8::Isolate::CreateParams create_params;
-    create_params.array_buffer_allocator = v8::ArrayBuffer::Allocator::NewDefaultAllocator();
+    create_params.array_buffer_allocator = new CArrayBufferAllocator();
     m_isolate = v8::Isolate::New(create_params);
+    m_isolate->SetData(CIsolateData::kDataSlot, new CIsolateData());
+
+    GetData()->gc.Attach(m_isolate);
+
+    CMemoryPressureWatcher::AddIsolate(m_isolate);
 }
 
 CIsolate::CIsolate(bool owner)
@@ -24,13 +151,40 @@ CIsolate::CIsolate()
     CIsolate::Init(false);
 }
 
-CIsolate::CIsolate(v8::Isolate *isolate) : m_isolate(isolate), m_owner(false)
+CIsolate::CIsolate(v8::Isolate *isolate) : m_isolate(isolate), m_owner(false), m_created(false)
 {
 }
 
 CIsolate::~CIsolate(void)
 {
-    if (m_owner) m_isolate->Dispose();
+    if (m_owner) Dispose();
+}
+
+void CIsolate::Dispose(void)
+{
+    if (!m_isolate) return;
+
+    // the instance which created the isolate would be left with a dangling pointer
+    if (!m_created) throw CJavascriptException("can't dispose an isolate created by another instance", ::PyExc_RuntimeError);
+
+    if (m_isolate->IsInUse()) throw CJavascriptException("can't dispose an entered isolate", ::PyExc_RuntimeError);
+
+    v8::ArrayBuffer::Allocator *allocator = m_isolate->GetArrayBufferAllocator();
+    CIsolateData *data = GetData();
+
+    CMemoryPressureWatcher::RemoveIsolate(m_isolate);
+
+    data->gc.Detach(m_isolate);
+    data->heap_tuner.reset();
+    data->global_template.Reset();
+
+    m_isolate->SetData(CIsolateData::kDataSlot, NULL);
+    m_isolate->Dispose();
+    m_isolate = NULL;
+    m_owner = false;
+
+    delete allocator;
+    delete data;
 }
 
 v8::Isolate *CIsolate::GetIsolate(void)
@@ -44,6 +198,184 @@ CJavascriptStackTracePtr CIsolate::GetCurrentStackTrace(int frame_limit,
     return CJavascriptStackTrace::GetCurrentStackTrace(m_isolate, frame_limit, options);
 }
 
+bool CIsolate::Idle(double deadline_ms)
+{
+    double deadline = CPlatform::GetPlatform()->MonotonicallyIncreasingTime() + deadline_ms / 1000;
+
+    CPlatform::PumpMessageLoop(m_isolate);
+
+    bool done;
+
+    Py_BEGIN_ALLOW_THREADS
+
+    done = m_isolate->IdleNotificationDeadline(deadline);
+
+    Py_END_ALLOW_THREADS
+
+    return done;
+}
+
+void CIsolate::WriteHeapSnapshot(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (fd < 0)
+    {
+        ::PyErr_SetFromErrnoWithFilename(::PyExc_OSError, path.c_str());
+
+        py::throw_error_already_set();
+    }
+
+    int error;
+
+    Py_BEGIN_ALLOW_THREADS
+
+    v8::HandleScope handle_scope(m_isolate);
+
+    {
+        std::unique_ptr<const v8::HeapSnapshot, CHeapSnapshotDeleter> snapshot(
+            m_isolate->GetHeapProfiler()->TakeHeapSnapshot());
+
+        CFileOutputStream stream(fd);
+
+        snapshot->Serialize(&stream, v8::HeapSnapshot::kJSON);
+
+        error = stream.GetErrno();
+    }
+
+    if (::close(fd) < 0 && !error) error = errno;
+
+    Py_END_ALLOW_THREADS
+
+    if (error)
+    {
+        errno = error;
+
+        ::PyErr_SetFromErrnoWithFilename(::PyExc_OSError, path.c_str());
+
+        py::throw_error_already_set();
+    }
+}
+
+void CIsolate::StartHeapTuning(size_t min_size, size_t max_size)
+{
+    if (!min_size || min_size > max_size)
+    {
+        throw CJavascriptException("the heap tuning range is empty", ::PyExc_ValueError);
+    }
+
+    CIsolateData *data = GetData();
+
+    data->heap_tuner.reset();
+    data->heap_tuner.reset(new CHeapTuner(m_isolate, min_size, max_size));
+}
+
+py::list CIsolate::GetHeapTuningLog(void)
+{
+    py::list log;
+
+    CHeapTuner *tuner = GetData()->heap_tuner.get();
+
+    if (!tuner) return log;
+
+    std::deque<CHeapTuner::Decision> decisions = tuner->GetDecisions();
+
+    for (std::deque<CHeapTuner::Decision>::const_iterator it = decisions.begin(); it != decisions.end(); it++)
+    {
+        log.append(py::make_tuple(it->time, it->action, it->old_limit, it->new_limit, it->reason));
+    }
+
+    return log;
+}
+
+bool CIsolate::StartAllocationSampling(uint64_t interval, int depth)
+{
+    return m_isolate->GetHeapProfiler()->StartSamplingHeapProfiler(interval, depth);
+}
+
+static py::tuple ConvertAllocationNode(v8::Isolate *isolate, const v8::AllocationProfile::Node *node)
+{
+    size_t self_bytes = 0;
+
+    for (std::vector<v8::AllocationProfile::Allocation>::const_iterator it = node->allocations.begin();
+            it != node->allocations.end(); it++)
+    {
+        self_bytes += it->size * it->count;
+    }
+
+    py::list children;
+
+    for (std::vector<v8::AllocationProfile::Node *>::const_iterator it = node->children.begin();
+            it != node->children.end(); it++)
+    {
+        children.append(ConvertAllocationNode(isolate, *it));
+    }
+
+    v8::String::Utf8Value name(isolate, node->name);
+    v8::String::Utf8Value script_name(isolate, node->script_name);
+
+    return py::make_tuple(std::string(*name, name.length()),
+                          std::string(*script_name, script_name.length()),
+                          node->line_number, node->column_number, self_bytes,
+                          py::tuple(children));
+}
+
+py::object CIsolate::StopAllocationSampling(void)
+{
+    v8::HandleScope handle_scope(m_isolate);
+
+    v8::HeapProfiler *profiler = m_isolate->GetHeapProfiler();
+
+    std::unique_ptr<v8::AllocationProfile> profile(profiler->GetAllocationProfile());
+
+    if (!profile) return py::object();
+
+    CSamplingHeapProfilerScope sampling(profiler);
+
+    return ConvertAllocationNode(m_isolate, profile->GetRootNode());
+}
+
+py::dict CIsolate::GetGCStats(void)
+{
+    const CGCStats& gc = GetData()->gc;
+
+    py::dict pauses;
+
+    for (size_t i = 0; i < CGCStats::kKinds; i++)
+    {
+        const CGCStats::Kind& kind = gc.GetKind(i);
+
+        py::list histogram;
+
+        for (size_t j = 0; j < CGCStats::kBuckets; j++) histogram.append(kind.buckets[j].load());
+
+        py::dict stats;
+
+        stats["count"] = kind.count.load();
+        stats["total"] = kind.total_us.load() / 1000.0;
+        stats["max"] = kind.max_us.load() / 1000.0;
+        stats["histogram"] = histogram;
+
+        pauses[CGCStats::KindName(i)] = stats;
+    }
+
+    py::dict result;
+
+    result["pauses"] = pauses;
+    result["heapBefore"] = gc.GetHeapBefore();
+    result["heapAfter"] = gc.GetHeapAfter();
+
+    return result;
+}
+
+void CIsolate::SetGCCallback(py::object callback)
+{
+    CIsolateData *data = GetData();
+
+    data->gc_callback = callback;
+    data->gc.SetListener(callback.is_none() ? NULL : PostGCEvents);
+}
+
 py::object CIsolate::GetCurrent(void)
 {
     v8::Isolate *isolate = v8::Isolate::GetCurrent();
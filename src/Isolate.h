@@ -2,11 +2,44 @@
 
 #include <v8.h>
 #include "Exception.h"
+#include "Allocator.h"
+#include "Cache.h"
+#include "GCStats.h"
+#include "HeapTuner.h"
+
+// Per-isolate settings shared by all the CIsolate instances wrapping the same v8::Isolate
+struct CIsolateData
+{
+    static const uint32_t kDataSlot = 0;
+
+    double idle_time;
+
+    // JavaScript wrappers of the Python objects, per context
+    CTracerCache tracers;
+
+    CGCStats gc;
+
+    // called with each GC event, from the task draining the events queued by the pauses
+    py::object gc_callback;
+
+    std::unique_ptr<CHeapTuner> heap_tuner;
+
+    // global object template of the contexts bound to a Python object
+    v8::Global<v8::ObjectTemplate> global_template;
+
+    CIsolateData() : idle_time(0) {}
+
+    static CIsolateData *Get(v8::Isolate *isolate) {
+        return static_cast<CIsolateData *>(isolate->GetData(kDataSlot));
+    }
+};
 
 class CIsolate
 {
     v8::Isolate *m_isolate;
     bool m_owner;
+    // created by this instance, not just wrapping an existing isolate
+    bool m_created;
     void Init(bool owner);
 public:
     CIsolate();
@@ -16,20 +49,96 @@ public:
 
     v8::Isolate *GetIsolate(void);
 
+    CIsolateData *GetData(void) {
+        return CIsolateData::Get(m_isolate);
+    }
+
+    CArrayBufferAllocator *GetArrayBufferAllocator(void) {
+        return static_cast<CArrayBufferAllocator *>(m_isolate->GetArrayBufferAllocator());
+    }
+
+    size_t GetArrayBufferLimit(void) {
+        return GetArrayBufferAllocator()->GetLimit();
+    }
+    void SetArrayBufferLimit(size_t limit) {
+        GetArrayBufferAllocator()->SetLimit(limit);
+    }
+    size_t GetArrayBufferLiveBytes(void) {
+        return GetArrayBufferAllocator()->GetLiveBytes();
+    }
+    size_t GetArrayBufferPeakBytes(void) {
+        return GetArrayBufferAllocator()->GetPeakBytes();
+    }
+    size_t GetArrayBufferTotalBytes(void) {
+        return GetArrayBufferAllocator()->GetTotalBytes();
+    }
+
+    size_t GetExternalMemory(void) {
+        v8::HeapStatistics stats;
+
+        m_isolate->GetHeapStatistics(&stats);
+
+        return stats.external_memory();
+    }
+
+    size_t GetUsedHeapSize(void) {
+        v8::HeapStatistics stats;
+
+        m_isolate->GetHeapStatistics(&stats);
+
+        return stats.used_heap_size();
+    }
+
     CJavascriptStackTracePtr GetCurrentStackTrace(int frame_limit,
             v8::StackTrace::StackTraceOptions options);
 
     static py::object GetCurrent(void);
 
+    bool Idle(double deadline_ms);
+
+    py::dict GetGCStats(void);
+
+    void WriteHeapSnapshot(const std::string& path);
+
+    void StartHeapTuning(size_t min_size, size_t max_size);
+    void StopHeapTuning(void) {
+        GetData()->heap_tuner.reset();
+    }
+    py::list GetHeapTuningLog(void);
+
+    bool StartAllocationSampling(uint64_t interval, int depth);
+    py::object StopAllocationSampling(void);
+
+    py::object GetGCCallback(void) {
+        return GetData()->gc_callback;
+    }
+    void SetGCCallback(py::object callback);
+
+    v8::MicrotasksPolicy GetMicrotasksPolicy(void) {
+        return m_isolate->GetMicrotasksPolicy();
+    }
+    void SetMicrotasksPolicy(v8::MicrotasksPolicy policy) {
+        m_isolate->SetMicrotasksPolicy(policy);
+    }
+
+    double GetIdleTime(void) {
+        return GetData()->idle_time;
+    }
+    void SetIdleTime(double idle_time) {
+        GetData()->idle_time = idle_time;
+    }
+
     void Enter(void) {
+        if (!m_isolate) throw CJavascriptException("the isolate has been disposed", ::PyExc_RuntimeError);
+
         m_isolate->Enter();
     }
     void Leave(void) {
         m_isolate->Exit();
     }
-    void Dispose(void) {
-        m_isolate->Dispose();
-    }
+
+    // Dispose the isolate with its per-isolate data, whoever created it
+    void Dispose(void);
 
     bool IsLocked(void) {
         return v8::Locker::IsLocked(m_isolate);
@@ -20,6 +20,47 @@ void CLocker::leave(void)
     Py_END_ALLOW_THREADS
 }
 
+void CContextScope::enter(void)
+{
+    if (m_entered) throw CJavascriptException("the scope has been entered", ::PyExc_RuntimeError);
+    if (!m_context->IsEntered()) throw CJavascriptException("the context has been disposed", ::PyExc_RuntimeError);
+
+    v8::Isolate *isolate = m_context->GetIsolate();
+
+    if (m_lock)
+    {
+        Py_BEGIN_ALLOW_THREADS
+
+        m_locker.reset(new v8::Locker(isolate));
+
+        Py_END_ALLOW_THREADS
+    }
+
+    isolate->Enter();
+    m_context->Enter();
+
+    m_entered = true;
+}
+
+void CContextScope::leave(void)
+{
+    if (!m_entered) return;
+
+    m_entered = false;
+
+    m_context->Leave();
+    m_context->GetIsolate()->Exit();
+
+    if (m_locker)
+    {
+        Py_BEGIN_ALLOW_THREADS
+
+        m_locker.reset();
+
+        Py_END_ALLOW_THREADS
+    }
+}
+
 bool CLocker::IsLocked()
 {
     return v8::Locker::IsLocked(v8::Isolate::GetCurrent());
@@ -42,6 +83,19 @@ void CLocker::Expose(void)
     .def("leave", &CLocker::leave)
     ;
 
+    py::class_<CContextScope, boost::noncopyable>("JSContextScope", py::no_init)
+    .def(py::init<CContextPtr, bool>((py::arg("context"),
+                                      py::arg("lock") = true),
+                                     "Create a scope locking the isolate of the context (unless lock is false), "
+                                     "then entering the isolate and the context."))
+
+    .add_property("context", &CContextScope::context, "The context of the scope.")
+
+    .def("entered", &CContextScope::entered)
+    .def("enter", &CContextScope::enter)
+    .def("leave", &CContextScope::leave)
+    ;
+
     py::class_<CUnlocker, boost::noncopyable>("JSUnlocker")
     .def("entered", &CUnlocker::entered)
     .def("enter", &CUnlocker::enter)
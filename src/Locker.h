@@ -27,6 +27,31 @@ public:
 };
 
 
+// Locks the isolate of a context, enters the isolate and then the context in a
+// single call, without allocating any handle, and leaves them in reverse order
+class CContextScope
+{
+    CContextPtr m_context;
+    bool m_lock;
+
+    std::unique_ptr<v8::Locker> m_locker;
+    bool m_entered;
+public:
+    CContextScope(CContextPtr context, bool lock = true)
+        : m_context(context), m_lock(lock), m_entered(false) {}
+
+    bool entered(void) {
+        return m_entered;
+    }
+    CContextPtr context(void) {
+        return m_context;
+    }
+
+    void enter(void);
+    void leave(void);
+};
+
+
 class CUnlocker
 {
     std::unique_ptr<v8::Unlocker> m_unlocker;
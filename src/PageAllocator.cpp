@@ -0,0 +1,155 @@
+#include "PageAllocator.h"
+
+#include <algorithm>
+
+#include <sys/mman.h>
+
+// transparent huge pages are only worth it for reservations spanning a few of them
+static const size_t kHugePageSize = 2 * 1024 * 1024;
+
+#if defined(__linux__) && !defined(MADV_POPULATE_WRITE)
+#  define MADV_POPULATE_WRITE 23
+#endif
+
+CPageAllocator::CPageAllocator(v8::PageAllocator *allocator, bool huge_pages, size_t prefault)
+    : m_allocator(allocator), m_huge_pages(huge_pages), m_prefault(prefault), m_reserved(0), m_committed(0)
+{
+}
+
+bool CPageAllocator::IsAccessible(Permission permissions)
+{
+    return permissions == kRead || permissions == kReadWrite ||
+           permissions == kReadWriteExecute || permissions == kReadExecute;
+}
+
+void CPageAllocator::Commit(uintptr_t start, uintptr_t end)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    // merge with the overlapping or adjacent ranges
+    std::map<uintptr_t, uintptr_t>::iterator it = m_accessible.upper_bound(start);
+
+    if (it != m_accessible.begin() && std::prev(it)->second >= start) it = std::prev(it);
+
+    size_t merged = 0;
+
+    while (it != m_accessible.end() && it->first <= end)
+    {
+        start = std::min(start, it->first);
+        end = std::max(end, it->second);
+        merged += it->second - it->first;
+
+        it = m_accessible.erase(it);
+    }
+
+    m_accessible[start] = end;
+    m_committed += (end - start) - merged;
+}
+
+void CPageAllocator::Decommit(uintptr_t start, uintptr_t end)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    std::map<uintptr_t, uintptr_t>::iterator it = m_accessible.upper_bound(start);
+
+    if (it != m_accessible.begin() && std::prev(it)->second > start) it = std::prev(it);
+
+    while (it != m_accessible.end() && it->first < end)
+    {
+        uintptr_t first = it->first, last = it->second;
+
+        it = m_accessible.erase(it);
+
+        if (first < start) m_accessible[first] = start;
+        if (last > end) m_accessible[end] = last;
+
+        m_committed -= std::min(last, end) - std::max(first, start);
+    }
+}
+
+void CPageAllocator::Advise(void *address, size_t length)
+{
+#if defined(MADV_HUGEPAGE)
+    if (m_huge_pages && length >= kHugePageSize) ::madvise(address, length, MADV_HUGEPAGE);
+#endif
+}
+
+void CPageAllocator::Prefault(void *address, size_t length)
+{
+#if defined(__linux__)
+    size_t budget = m_prefault.load(std::memory_order_relaxed);
+
+    while (budget)
+    {
+        size_t size = std::min(budget, length);
+
+        if (m_prefault.compare_exchange_weak(budget, budget - size, std::memory_order_relaxed))
+        {
+            // populates the page tables without touching the content, a no-op on old kernels
+            ::madvise(address, size, MADV_POPULATE_WRITE);
+
+            return;
+        }
+    }
+#endif
+}
+
+void *CPageAllocator::AllocatePages(void *address, size_t length, size_t alignment, Permission permissions)
+{
+    void *result = m_allocator->AllocatePages(address, length, alignment, permissions);
+
+    if (!result) return result;
+
+    m_reserved += length;
+
+    Advise(result, length);
+
+    if (IsAccessible(permissions))
+    {
+        Commit((uintptr_t) result, (uintptr_t) result + length);
+
+        if (permissions == kReadWrite) Prefault(result, length);
+    }
+
+    return result;
+}
+
+bool CPageAllocator::FreePages(void *address, size_t length)
+{
+    if (!m_allocator->FreePages(address, length)) return false;
+
+    Decommit((uintptr_t) address, (uintptr_t) address + length);
+
+    m_reserved -= length;
+
+    return true;
+}
+
+bool CPageAllocator::ReleasePages(void *address, size_t length, size_t new_length)
+{
+    if (!m_allocator->ReleasePages(address, length, new_length)) return false;
+
+    Decommit((uintptr_t) address + new_length, (uintptr_t) address + length);
+
+    m_reserved -= length - new_length;
+
+    return true;
+}
+
+bool CPageAllocator::SetPermissions(void *address, size_t length, Permission permissions)
+{
+    if (!m_allocator->SetPermissions(address, length, permissions)) return false;
+
+    if (IsAccessible(permissions))
+    {
+        Commit((uintptr_t) address, (uintptr_t) address + length);
+
+        if (permissions == kReadWrite) Prefault(address, length);
+    }
+    else
+    {
+        Decommit((uintptr_t) address, (uintptr_t) address + length);
+    }
+
+    return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <mutex>
+
+#include <v8-platform.h>
+
+// Page allocator installed in front of the default one of the platform.
+// It hints the kernel to back the V8 reservations with transparent huge
+// pages, optionally pre-faults the first pages made accessible (the initial
+// heap) and keeps the per-process accounting of the reserved and committed
+// (accessible) bytes.
+class CPageAllocator : public v8::PageAllocator
+{
+    v8::PageAllocator *m_allocator;
+
+    bool m_huge_pages;
+    std::atomic<size_t> m_prefault;
+
+    std::atomic<size_t> m_reserved;
+    std::atomic<size_t> m_committed;
+
+    // accessible ranges, start -> end
+    std::mutex m_lock;
+    std::map<uintptr_t, uintptr_t> m_accessible;
+
+    static bool IsAccessible(Permission permissions);
+
+    void Commit(uintptr_t start, uintptr_t end);
+    void Decommit(uintptr_t start, uintptr_t end);
+
+    void Advise(void *address, size_t length);
+    void Prefault(void *address, size_t length);
+public:
+    CPageAllocator(v8::PageAllocator *allocator, bool huge_pages, size_t prefault);
+
+    size_t GetReservedBytes(void) const {
+        return m_reserved;
+    }
+    size_t GetCommittedBytes(void) const {
+        return m_committed;
+    }
+    bool IsHugePagesEnabled(void) const {
+        return m_huge_pages;
+    }
+
+    virtual size_t AllocatePageSize() override {
+        return m_allocator->AllocatePageSize();
+    }
+    virtual size_t CommitPageSize() override {
+        return m_allocator->CommitPageSize();
+    }
+    virtual void SetRandomMmapSeed(int64_t seed) override {
+        m_allocator->SetRandomMmapSeed(seed);
+    }
+    virtual void *GetRandomMmapAddr() override {
+        return m_allocator->GetRandomMmapAddr();
+    }
+
+    virtual void *AllocatePages(void *address, size_t length, size_t alignment, Permission permissions) override;
+    virtual bool FreePages(void *address, size_t length) override;
+    virtual bool ReleasePages(void *address, size_t length, size_t new_length) override;
+    virtual bool SetPermissions(void *address, size_t length, Permission permissions) override;
+
+    virtual bool DiscardSystemPages(void *address, size_t size) override {
+        return m_allocator->DiscardSystemPages(address, size);
+    }
+};
@@ -1,11 +1,79 @@
+#include <exception>
+
 #include "libplatform/libplatform.h"
 
 #include "Platform.h"
 
 std::unique_ptr<v8::Platform> CPlatform::platform;
+std::unique_ptr<CPageAllocator> CPlatform::allocator;
+std::unique_ptr<v8::Platform> CPlatform::forwarding;
 bool CPlatform::inited = false;
 
-void CPlatform::Init()
+thread_local int CMessageLoopScope::s_depth = 0;
+
+// The default platform doesn't take a page allocator, so it is wrapped by a
+// platform forwarding everything to it but the page allocator.
+class CForwardingPlatform : public v8::Platform
+{
+    v8::Platform *m_platform;
+    v8::PageAllocator *m_allocator;
+public:
+    CForwardingPlatform(v8::Platform *platform, v8::PageAllocator *allocator)
+        : m_platform(platform), m_allocator(allocator)
+    {
+    }
+
+    virtual v8::PageAllocator *GetPageAllocator() override {
+        return m_allocator;
+    }
+    virtual void OnCriticalMemoryPressure() override {
+        m_platform->OnCriticalMemoryPressure();
+    }
+    virtual bool OnCriticalMemoryPressure(size_t length) override {
+        return m_platform->OnCriticalMemoryPressure(length);
+    }
+    virtual int NumberOfWorkerThreads() override {
+        return m_platform->NumberOfWorkerThreads();
+    }
+    virtual std::shared_ptr<v8::TaskRunner> GetForegroundTaskRunner(v8::Isolate *isolate) override {
+        return m_platform->GetForegroundTaskRunner(isolate);
+    }
+    virtual void CallOnWorkerThread(std::unique_ptr<v8::Task> task) override {
+        m_platform->CallOnWorkerThread(std::move(task));
+    }
+    virtual void CallBlockingTaskOnWorkerThread(std::unique_ptr<v8::Task> task) override {
+        m_platform->CallBlockingTaskOnWorkerThread(std::move(task));
+    }
+    virtual void CallLowPriorityTaskOnWorkerThread(std::unique_ptr<v8::Task> task) override {
+        m_platform->CallLowPriorityTaskOnWorkerThread(std::move(task));
+    }
+    virtual void CallDelayedOnWorkerThread(std::unique_ptr<v8::Task> task, double delay_in_seconds) override {
+        m_platform->CallDelayedOnWorkerThread(std::move(task), delay_in_seconds);
+    }
+    virtual bool IdleTasksEnabled(v8::Isolate *isolate) override {
+        return m_platform->IdleTasksEnabled(isolate);
+    }
+    virtual std::unique_ptr<v8::JobHandle> PostJob(v8::TaskPriority priority, std::unique_ptr<v8::JobTask> job_task) override {
+        return m_platform->PostJob(priority, std::move(job_task));
+    }
+    virtual double MonotonicallyIncreasingTime() override {
+        return m_platform->MonotonicallyIncreasingTime();
+    }
+    virtual double CurrentClockTimeMillis() override {
+        return m_platform->CurrentClockTimeMillis();
+    }
+    virtual StackTracePrinter GetStackTracePrinter() override {
+        return m_platform->GetStackTracePrinter();
+    }
+    virtual v8::TracingController *GetTracingController() override {
+        return m_platform->GetTracingController();
+    }
+    virtual void DumpWithoutCrashing() override {
+        m_platform->DumpWithoutCrashing();
+    }
+};
+
+void CPlatform::Init(bool huge_pages, size_t prefault, bool page_accounting)
 {
     if(inited) return;
 
@@ -14,8 +82,32 @@ void CPlatform::Init()
 
     platform = v8::platform::NewDefaultPlatform();
 
-    v8::V8::InitializePlatform(platform.get());
+    if (huge_pages || prefault || page_accounting)
+    {
+        allocator.reset(new CPageAllocator(platform->GetPageAllocator(), huge_pages, prefault));
+        forwarding.reset(new CForwardingPlatform(platform.get(), allocator.get()));
+    }
+
+    v8::V8::InitializePlatform(GetPlatform());
     v8::V8::Initialize();
 
     inited = true;
 }
+
+bool CPlatform::PumpMessageLoop(v8::Isolate *isolate)
+{
+    if (!inited) return false;
+
+    bool pumped = false;
+
+    // the message loop belongs to the default platform, even behind the forwarding one
+    while (v8::platform::PumpMessageLoop(platform.get(), isolate)) pumped = true;
+
+    return pumped;
+}
+
+CMessageLoopScope::~CMessageLoopScope()
+{
+    // a failed execution leaves the tasks, which may call back Python, to the next one
+    if (--s_depth == 0 && !std::uncaught_exception()) CPlatform::PumpMessageLoop(m_isolate);
+}
@@ -4,6 +4,7 @@
 #include <v8.h>
 
 #include "Config.h"
+#include "PageAllocator.h"
 
 
 class CPlatform
@@ -11,6 +12,10 @@ class CPlatform
 private:
     static bool inited;
     static std::unique_ptr<v8::Platform> platform;
+
+    // forwards to the default platform with the custom page allocator, if installed
+    static std::unique_ptr<CPageAllocator> allocator;
+    static std::unique_ptr<v8::Platform> forwarding;
     constexpr static const char *icu_data = ICU_DATA;
 
     const char *GetICUDataFile()
@@ -28,5 +33,40 @@ public:
     CPlatform() : argv(std::string()) {};
     CPlatform(std::string argv0) : argv(argv0) {};
     ~CPlatform() {};
-    void Init();
+    void Init(bool huge_pages = false, size_t prefault = 0, bool page_accounting = false);
+
+    static v8::Platform *GetPlatform(void) {
+        return forwarding ? forwarding.get() : platform.get();
+    }
+
+    static CPageAllocator *GetPageAllocator(void) {
+        return allocator.get();
+    }
+
+    static bool IsHugePagesEnabled(void) {
+        return allocator && allocator->IsHugePagesEnabled();
+    }
+    static size_t GetReservedBytes(void) {
+        return allocator ? allocator->GetReservedBytes() : 0;
+    }
+    static size_t GetCommittedBytes(void) {
+        return allocator ? allocator->GetCommittedBytes() : 0;
+    }
+
+    // Run the pending foreground tasks (GC steps, finalizers, ...) posted for the isolate
+    static bool PumpMessageLoop(v8::Isolate *isolate);
+};
+
+// Pumps the message loop once the outermost execution of the thread returns, so the
+// second pass weak callbacks and the GC events a normal GC posts don't pile up.
+class CMessageLoopScope
+{
+    static thread_local int s_depth;
+
+    v8::Isolate *m_isolate;
+public:
+    CMessageLoopScope(v8::Isolate *isolate) : m_isolate(isolate) {
+        s_depth++;
+    }
+    ~CMessageLoopScope();
 };
@@ -0,0 +1,5 @@
+#include "Pool.h"
+
+std::atomic<size_t> CPoolStats::allocated(0);
+std::atomic<size_t> CPoolStats::freed(0);
+std::atomic<size_t> CPoolStats::reused(0);
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+// Wrapper churn counters, shared by all the pools
+struct CPoolStats
+{
+    static std::atomic<size_t> allocated;
+    static std::atomic<size_t> freed;
+    static std::atomic<size_t> reused;
+};
+
+// Per-thread free lists of fixed size blocks. A block may be released on
+// another thread than the one which allocated it, it then simply moves to
+// the free list of that thread.
+template <size_t Size>
+class CBlockPool
+{
+    struct Block
+    {
+        Block *next;
+    };
+
+    struct FreeList
+    {
+        Block *head;
+        size_t count;
+
+        FreeList() : head(NULL), count(0) {}
+        ~FreeList() {
+            while (head)
+            {
+                Block *block = head;
+
+                head = block->next;
+
+                ::operator delete(block);
+            }
+        }
+    };
+
+    static FreeList& Local(void) {
+        static thread_local FreeList s_list;
+
+        return s_list;
+    }
+public:
+    // blocks cached per thread, the rest goes back to the heap
+    static const size_t kMaxCached = 4096;
+
+    static void *Allocate(void) {
+        CPoolStats::allocated.fetch_add(1, std::memory_order_relaxed);
+
+        FreeList& list = Local();
+
+        if (list.head)
+        {
+            Block *block = list.head;
+
+            list.head = block->next;
+            list.count--;
+
+            CPoolStats::reused.fetch_add(1, std::memory_order_relaxed);
+
+            return block;
+        }
+
+        return ::operator new(Size);
+    }
+
+    static void Free(void *p) {
+        CPoolStats::freed.fetch_add(1, std::memory_order_relaxed);
+
+        FreeList& list = Local();
+
+        if (list.count >= kMaxCached)
+        {
+            ::operator delete(p);
+        }
+        else
+        {
+            Block *block = static_cast<Block *>(p);
+
+            block->next = list.head;
+            list.head = block;
+            list.count++;
+        }
+    }
+};
+
+// Standard allocator on top of CBlockPool, meant for std::allocate_shared so
+// the object and its control block come from a single pooled block.
+template <typename T>
+class CPoolAllocator
+{
+    static const size_t kBlockSize = (sizeof(T) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+public:
+    typedef T value_type;
+
+    CPoolAllocator() {}
+    template <typename U> CPoolAllocator(const CPoolAllocator<U>&) {}
+
+    T *allocate(size_t n) {
+        if (n != 1) return static_cast<T *>(::operator new(n * sizeof(T)));
+
+        return static_cast<T *>(CBlockPool<kBlockSize>::Allocate());
+    }
+
+    void deallocate(T *p, size_t n) {
+        if (n != 1)
+        {
+            ::operator delete(p);
+        }
+        else
+        {
+            CBlockPool<kBlockSize>::Free(p);
+        }
+    }
+
+    template <typename U> bool operator==(const CPoolAllocator<U>&) const {
+        return true;
+    }
+    template <typename U> bool operator!=(const CPoolAllocator<U>&) const {
+        return false;
+    }
+};
@@ -0,0 +1,173 @@
+#include <chrono>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+
+#include "Pressure.h"
+
+// The share of time (PSI avg10, in percent) some or all the tasks of the cgroup
+// were stalled on memory, treated as moderate or critical pressure respectively
+#define PSI_MODERATE_THRESHOLD 10.0
+#define PSI_CRITICAL_THRESHOLD 5.0
+
+std::mutex CMemoryPressureWatcher::s_lock;
+std::set<v8::Isolate *> CMemoryPressureWatcher::s_isolates;
+std::unique_ptr<CMemoryPressureWatcher> CMemoryPressureWatcher::s_watcher;
+
+static bool ReadValue(const std::string& filename, double& value)
+{
+    std::ifstream file(filename);
+    std::string text;
+
+    if (!(file >> text) || text == "max") return false;
+
+    value = strtod(text.c_str(), NULL);
+
+    return true;
+}
+
+static double ReadStall(const std::string& filename, const char *kind)
+{
+    std::ifstream file(filename);
+    std::string line;
+
+    while (std::getline(file, line))
+    {
+        if (line.compare(0, strlen(kind), kind) != 0) continue;
+
+        size_t pos = line.find("avg10=");
+
+        if (pos != std::string::npos) return strtod(line.c_str() + pos + 6, NULL);
+    }
+
+    return 0;
+}
+
+CMemoryPressureWatcher::~CMemoryPressureWatcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_stopped = true;
+    }
+
+    m_cond.notify_all();
+
+    if (m_thread.joinable()) m_thread.join();
+}
+
+void CMemoryPressureWatcher::AddIsolate(v8::Isolate *isolate)
+{
+    std::lock_guard<std::mutex> lock(s_lock);
+
+    s_isolates.insert(isolate);
+}
+
+void CMemoryPressureWatcher::RemoveIsolate(v8::Isolate *isolate)
+{
+    std::lock_guard<std::mutex> lock(s_lock);
+
+    s_isolates.erase(isolate);
+}
+
+void CMemoryPressureWatcher::Notify(v8::MemoryPressureLevel level)
+{
+    std::lock_guard<std::mutex> lock(s_lock);
+
+    for (std::set<v8::Isolate *>::const_iterator it = s_isolates.begin(); it != s_isolates.end(); it++)
+    {
+        (*it)->MemoryPressureNotification(level);
+    }
+}
+
+std::string CMemoryPressureWatcher::FindCgroup(void)
+{
+    // cgroup v2 has a single hierarchy, listed as "0::/path" in /proc/self/cgroup
+    std::ifstream file("/proc/self/cgroup");
+    std::string line;
+
+    while (std::getline(file, line))
+    {
+        if (line.compare(0, 3, "0::") == 0) return "/sys/fs/cgroup" + line.substr(3);
+    }
+
+    return std::string();
+}
+
+v8::MemoryPressureLevel CMemoryPressureWatcher::Measure(void)
+{
+    v8::MemoryPressureLevel level = v8::MemoryPressureLevel::kNone;
+
+    double current, limit;
+
+    if (ReadValue(m_path + "/memory.current", current) &&
+            (ReadValue(m_path + "/memory.max", limit) || ReadValue(m_path + "/memory.high", limit)) && limit > 0)
+    {
+        if (current >= limit * m_critical)
+            level = v8::MemoryPressureLevel::kCritical;
+        else if (current >= limit * m_moderate)
+            level = v8::MemoryPressureLevel::kModerate;
+    }
+
+    std::string pressure = m_path + "/memory.pressure";
+
+    if (ReadStall(pressure, "full") >= PSI_CRITICAL_THRESHOLD)
+        level = v8::MemoryPressureLevel::kCritical;
+    else if (level == v8::MemoryPressureLevel::kNone && ReadStall(pressure, "some") >= PSI_MODERATE_THRESHOLD)
+        level = v8::MemoryPressureLevel::kModerate;
+
+    return level;
+}
+
+void CMemoryPressureWatcher::Run(void)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (!m_stopped)
+    {
+        v8::MemoryPressureLevel level = Measure();
+
+        // Only the changes are forwarded, V8 keeps the last level and
+        // a critical notification already triggers a full GC
+        if (level != m_level)
+        {
+            m_level = level;
+
+            Notify(level);
+        }
+
+        m_cond.wait_for(lock, std::chrono::milliseconds(m_interval));
+    }
+}
+
+bool CMemoryPressureWatcher::Start(const std::string& path, int interval, double moderate, double critical)
+{
+    Stop();
+
+    std::string cgroup = path.empty() ? FindCgroup() : path;
+
+    std::ifstream file(cgroup + "/memory.current");
+
+    if (cgroup.empty() || !file) return false;
+
+    s_watcher.reset(new CMemoryPressureWatcher(cgroup, interval > 0 ? interval : 100, moderate, critical));
+    s_watcher->m_thread = std::thread(&CMemoryPressureWatcher::Run, s_watcher.get());
+
+    return true;
+}
+
+void CMemoryPressureWatcher::Stop(void)
+{
+    if (!s_watcher) return;
+
+    bool pressured = s_watcher->m_level != v8::MemoryPressureLevel::kNone;
+
+    s_watcher.reset();
+
+    if (pressured) Notify(v8::MemoryPressureLevel::kNone);
+}
+
+v8::MemoryPressureLevel CMemoryPressureWatcher::GetLevel(void)
+{
+    return s_watcher ? s_watcher->m_level.load() : v8::MemoryPressureLevel::kNone;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <set>
+#include <atomic>
+#include <string>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <condition_variable>
+
+#include <v8.h>
+
+// Watches the cgroup v2 memory controller of the process and forwards the
+// memory pressure to all the live isolates, so V8 collects before the
+// container gets OOM-killed.
+class CMemoryPressureWatcher
+{
+    static std::mutex s_lock;
+    static std::set<v8::Isolate *> s_isolates;
+    static std::unique_ptr<CMemoryPressureWatcher> s_watcher;
+
+    std::string m_path;
+    int m_interval;
+    double m_moderate, m_critical;
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_stopped;
+
+    std::atomic<v8::MemoryPressureLevel> m_level;
+
+    CMemoryPressureWatcher(const std::string& path, int interval, double moderate, double critical)
+        : m_path(path), m_interval(interval), m_moderate(moderate), m_critical(critical),
+          m_stopped(false), m_level(v8::MemoryPressureLevel::kNone)
+    {
+    }
+
+    void Run(void);
+    v8::MemoryPressureLevel Measure(void);
+
+    static std::string FindCgroup(void);
+    static void Notify(v8::MemoryPressureLevel level);
+public:
+    ~CMemoryPressureWatcher();
+
+    static void AddIsolate(v8::Isolate *isolate);
+    static void RemoveIsolate(v8::Isolate *isolate);
+
+    static bool Start(const std::string& path, int interval, double moderate, double critical);
+    static void Stop(void);
+
+    static v8::MemoryPressureLevel GetLevel(void);
+};
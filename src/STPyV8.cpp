@@ -2,6 +2,7 @@
 #include "Exception.h"
 #include "Wrapper.h"
 #include "Context.h"
+#include "ContextPool.h"
 #include "Engine.h"
 #include "Locker.h"
 
@@ -11,6 +12,7 @@ BOOST_PYTHON_MODULE(_STPyV8)
     CJavascriptException::Expose();
     CWrapper::Expose();
     CContext::Expose();
+    CContextPool::Expose();
     CEngine::Expose();
     CLocker::Expose();
 }
@@ -0,0 +1,101 @@
+#include "Watchdog.h"
+
+CWatchdog::CWatchdog()
+{
+    std::thread(&CWatchdog::Watch, this).detach();
+}
+
+CWatchdog& CWatchdog::Instance(void)
+{
+    // never destroyed, the thread may still wait on it at exit
+    static CWatchdog *s_watchdog = new CWatchdog();
+
+    return *s_watchdog;
+}
+
+void CWatchdog::Watch(void)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true)
+    {
+        if (m_timers.empty())
+        {
+            m_cond.wait(lock);
+        }
+        else if (Clock::now() < m_timers.begin()->first)
+        {
+            m_cond.wait_until(lock, m_timers.begin()->first);
+        }
+        else
+        {
+            CTimer *timer = m_timers.begin()->second;
+
+            m_timers.erase(m_timers.begin());
+
+            timer->m_armed = false;
+            timer->Expire();
+        }
+    }
+}
+
+void CWatchdog::CTimer::Arm(double timeout)
+{
+    CWatchdog& watchdog = Instance();
+
+    Clock::time_point when = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(timeout));
+
+    std::lock_guard<std::mutex> lock(watchdog.m_mutex);
+
+    if (m_armed) watchdog.m_timers.erase(m_timer);
+
+    m_timer = watchdog.m_timers.insert(std::make_pair(when, this));
+    m_armed = true;
+
+    // the watchdog only has to wake up earlier for a new first timer
+    if (m_timer == watchdog.m_timers.begin()) watchdog.m_cond.notify_one();
+}
+
+bool CWatchdog::CTimer::Cancel(void)
+{
+    CWatchdog& watchdog = Instance();
+
+    std::lock_guard<std::mutex> lock(watchdog.m_mutex);
+
+    if (!m_armed) return false;
+
+    watchdog.m_timers.erase(m_timer);
+
+    m_armed = false;
+
+    return true;
+}
+
+CWatchdog::CDeadline::CDeadline(v8::Isolate *isolate, double timeout)
+    : m_isolate(isolate), m_expired(false), m_cancelled(false)
+{
+    Arm(timeout);
+}
+
+void CWatchdog::CDeadline::Expire(void)
+{
+    m_expired = true;
+
+    // thread safe, the execution stops at the next interrupt check
+    m_isolate->TerminateExecution();
+}
+
+bool CWatchdog::CDeadline::Disarm(void)
+{
+    // the watchdog lock orders the expiration before the check
+    Cancel();
+
+    if (m_expired && !m_cancelled)
+    {
+        m_isolate->CancelTerminateExecution();
+
+        m_cancelled = true;
+    }
+
+    return m_expired;
+}
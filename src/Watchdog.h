@@ -0,0 +1,101 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+
+#include <v8.h>
+
+#include "Exception.h"
+
+// A single thread expiring the timers armed on the executions (deadlines,
+// CPU budgets...), whatever the number of isolates and pending timers.
+class CWatchdog
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    class CTimer;
+private:
+    // the pending timers, the earliest first
+    typedef std::multimap<Clock::time_point, CTimer *> Timers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    Timers m_timers;
+
+    CWatchdog();
+
+    void Watch(void);
+
+    // started with the first timer and never stopped
+    static CWatchdog& Instance(void);
+public:
+    class CTimer
+    {
+        bool m_armed;
+        Timers::iterator m_timer;
+
+        friend class CWatchdog;
+    protected:
+        // Called from the watchdog thread, with its lock held
+        virtual void Expire(void) = 0;
+    public:
+        CTimer() : m_armed(false) {}
+        virtual ~CTimer() {
+            Cancel();
+        }
+
+        // Arm (or re-arm) the timer to expire after the timeout (in seconds)
+        void Arm(double timeout);
+        // Returns false if the timer was not armed anymore
+        bool Cancel(void);
+    };
+
+    // Terminates the execution of the isolate once the timeout expires, until disarmed
+    class CDeadline : public CTimer
+    {
+        v8::Isolate *m_isolate;
+        bool m_expired, m_cancelled;
+    protected:
+        virtual void Expire(void) override;
+    public:
+        CDeadline(v8::Isolate *isolate, double timeout);
+        ~CDeadline() {
+            Disarm();
+        }
+
+        // Returns true if the deadline expired, the termination is then cancelled so the isolate can run again
+        bool Disarm(void);
+    };
+
+    // Run the execution, raising JSTimeoutError if it outlives the timeout (0 means no timeout)
+    template <typename Func>
+    static py::object Run(v8::Isolate *isolate, double timeout, Func func)
+    {
+        if (timeout <= 0) return func();
+
+        CDeadline deadline(isolate, timeout);
+
+        py::object result;
+
+        try
+        {
+            result = func();
+        }
+        catch (...)
+        {
+            if (!deadline.Disarm()) throw;
+
+            ::PyErr_Clear();
+
+            throw CJavascriptException("execution timed out", CJavascriptException::s_timeout_error);
+        }
+
+        if (deadline.Disarm()) throw CJavascriptException("execution timed out", CJavascriptException::s_timeout_error);
+
+        return result;
+    }
+};
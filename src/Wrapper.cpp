@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <string.h>
 #include <iostream>
 #include <vector>
 
@@ -10,6 +11,9 @@
 
 #include "Wrapper.h"
 #include "Context.h"
+#include "Platform.h"
+#include "Watchdog.h"
+#include "CpuTime.h"
 #include "Utils.h"
 
 
@@ -97,6 +101,9 @@ void CWrapper::Expose(void)
 
     py::class_<CJavascriptFunction, py::bases<CJavascriptObject>, boost::noncopyable>("JSFunction", py::no_init)
     .def("__call__", py::raw_function(&CJavascriptFunction::CallWithArgs))
+    .def("callWithTimeout", py::raw_function(&CJavascriptFunction::CallWithTimeout, 2),
+         "callWithTimeout(timeout, *args, **kwds) calls the function, a positive timeout (in seconds) "
+         "terminates the execution and raises JSTimeoutError once it expires.")
 
     .def("apply", &CJavascriptFunction::ApplyJavascript,
          (py::arg("self"),
@@ -245,6 +252,7 @@ void CPythonObject::ThrowIf(v8::Isolate* isolate)
   }
 
 #define TRY_HANDLE_EXCEPTION(value) _TERMINATE_CALLBACK_EXECUTION_CHECK(value) \
+                                    CCallbackStats callback_stats(info.GetIsolate()); \
                                     BEGIN_HANDLE_PYTHON_EXCEPTION \
                                     {
 #define END_HANDLE_EXCEPTION(value) } \
@@ -269,7 +277,9 @@ void CPythonObject::NamedGetter(v8::Local<v8::Name> prop, const v8::PropertyCall
 
     CPythonGIL python_gil;
 
-    py::object obj = CJavascriptObject::Wrap(info.Holder());
+    py::object obj = GetHolder(info.Holder());
+
+    if (obj.is_none()) return;
 
     v8::String::Utf8Value name(info.GetIsolate(), v8::Local<v8::String>::Cast(prop));
     if (PyGen_Check(obj.ptr())) CALLBACK_RETURN(v8::Undefined(info.GetIsolate()));
@@ -331,7 +341,9 @@ void CPythonObject::NamedSetter(v8::Local<v8::Name> prop, v8::Local<v8::Value> v
 
     CPythonGIL python_gil;
 
-    py::object obj = CJavascriptObject::Wrap(info.Holder());
+    py::object obj = GetHolder(info.Holder());
+
+    if (obj.is_none()) return;
 
     v8::String::Utf8Value name(info.GetIsolate(), prop);
     py::object newval = CJavascriptObject::Wrap(value);
@@ -391,7 +403,9 @@ void CPythonObject::NamedQuery(v8::Local<v8::Name> prop, const v8::PropertyCallb
 
     CPythonGIL python_gil;
 
-    py::object obj = CJavascriptObject::Wrap(info.Holder());
+    py::object obj = GetHolder(info.Holder());
+
+    if (obj.is_none()) return;
 
     v8::String::Utf8Value name(info.GetIsolate(), prop);
 
@@ -411,7 +425,9 @@ void CPythonObject::NamedDeleter(v8::Local<v8::Name> prop, const v8::PropertyCal
 
     CPythonGIL python_gil;
 
-    py::object obj = CJavascriptObject::Wrap(info.Holder());
+    py::object obj = GetHolder(info.Holder());
+
+    if (obj.is_none()) return;
 
     v8::String::Utf8Value name(info.GetIsolate(), prop);
 
@@ -458,7 +474,9 @@ void CPythonObject::NamedEnumerator(const v8::PropertyCallbackInfo<v8::Array>& i
 
     CPythonGIL python_gil;
 
-    py::object obj = CJavascriptObject::Wrap(info.Holder());
+    py::object obj = GetHolder(info.Holder());
+
+    if (obj.is_none()) return;
 
     py::list keys;
     bool filter_name = false;
@@ -760,6 +778,128 @@ v8::Handle<v8::ObjectTemplate> CPythonObject::CreateObjectTemplate(v8::Isolate *
     return handle_scope.Escape(clazz);
 }
 
+// Keeps the Python object bound as global alive as long as the context
+struct CGlobalBinding
+{
+    py::object global;
+    v8::Global<v8::Context> context;
+
+    static void WeakCallback(const v8::WeakCallbackInfo<CGlobalBinding>& info)
+    {
+        info.GetParameter()->context.Reset();
+        info.SetSecondPassCallback(DisposeCallback);
+    }
+
+    static void DisposeCallback(const v8::WeakCallbackInfo<CGlobalBinding>& info)
+    {
+        CPythonGIL python_gil;
+
+        delete info.GetParameter();
+    }
+};
+
+static CGlobalBinding *GetGlobalBinding(v8::Handle<v8::Context> ctxt)
+{
+    if (ctxt->GetNumberOfEmbedderDataFields() <= CPythonObject::kGlobalDataIndex) return NULL;
+
+    return static_cast<CGlobalBinding *>(ctxt->GetAlignedPointerFromEmbedderData(CPythonObject::kGlobalDataIndex));
+}
+
+v8::Handle<v8::ObjectTemplate> CPythonObject::GetGlobalTemplate(v8::Isolate *isolate)
+{
+    v8::EscapableHandleScope handle_scope(isolate);
+
+    CIsolateData *data = CIsolateData::Get(isolate);
+
+    if (data->global_template.IsEmpty())
+    {
+        v8::Local<v8::ObjectTemplate> clazz = v8::ObjectTemplate::New(isolate);
+
+        // only the lookups missing on the global object and its prototypes reach Python,
+        // the assignments and deletions stay on the global object like with a prototype
+        v8::PropertyHandlerFlags flags = static_cast<v8::PropertyHandlerFlags>(
+                                             static_cast<int>(v8::PropertyHandlerFlags::kNonMasking) |
+                                             static_cast<int>(v8::PropertyHandlerFlags::kOnlyInterceptStrings));
+
+        clazz->SetHandler(v8::NamedPropertyHandlerConfiguration(NamedGetter, NULL, NamedQuery, NULL,
+                          NamedEnumerator, v8::Handle<v8::Value>(), flags));
+
+        data->global_template.Reset(isolate, clazz);
+    }
+
+    return handle_scope.Escape(v8::Local<v8::ObjectTemplate>::New(isolate, data->global_template));
+}
+
+void CPythonObject::BindGlobal(v8::Handle<v8::Context> ctxt, py::object global)
+{
+    UnbindGlobal(ctxt);
+
+    if (global.is_none()) return;
+
+    CGlobalBinding *binding = new CGlobalBinding();
+
+    binding->global = global;
+    binding->context.Reset(ctxt->GetIsolate(), ctxt);
+    binding->context.SetWeak(binding, CGlobalBinding::WeakCallback, v8::WeakCallbackType::kParameter);
+
+    ctxt->SetAlignedPointerInEmbedderData(kGlobalDataIndex, binding);
+
+    // The interceptors only see what Object.prototype misses, so the members it
+    // shares with the Python object (toString, valueOf...) are shadowed by own
+    // accessors, keeping the Python object first as when it was the prototype
+    v8::Isolate *isolate = ctxt->GetIsolate();
+    v8::HandleScope handle_scope(isolate);
+    v8::Context::Scope context_scope(ctxt);
+
+    v8::Local<v8::Object> object = ctxt->Global();
+    v8::Local<v8::Value> proto;
+    v8::Local<v8::Array> names;
+
+    if (!object->Get(ctxt, v8::String::NewFromUtf8(isolate, "__proto__").ToLocalChecked()).ToLocal(&proto) ||
+        !proto->IsObject() || !proto.As<v8::Object>()->GetOwnPropertyNames(ctxt, v8::SKIP_SYMBOLS).ToLocal(&names)) return;
+
+    CPythonGIL python_gil;
+
+    for (uint32_t i = 0; i < names->Length(); i++)
+    {
+        v8::Local<v8::Value> name = names->Get(ctxt, i).ToLocalChecked();
+        v8::String::Utf8Value str(isolate, name);
+
+        if (!*str || strcmp(*str, "__proto__") == 0 || !::PyObject_HasAttrString(global.ptr(), *str)) continue;
+
+        object->SetNativeDataProperty(ctxt, name.As<v8::Name>(), NamedGetter, NULL,
+                                      v8::Handle<v8::Value>(), v8::DontEnum).FromMaybe(false);
+    }
+}
+
+void CPythonObject::UnbindGlobal(v8::Handle<v8::Context> ctxt)
+{
+    CGlobalBinding *binding = GetGlobalBinding(ctxt);
+
+    if (!binding) return;
+
+    ctxt->SetAlignedPointerInEmbedderData(kGlobalDataIndex, NULL);
+
+    CPythonGIL python_gil;
+
+    delete binding;
+}
+
+py::object CPythonObject::GetGlobal(v8::Handle<v8::Context> ctxt)
+{
+    CGlobalBinding *binding = GetGlobalBinding(ctxt);
+
+    return binding ? binding->global : py::object();
+}
+
+py::object CPythonObject::GetHolder(v8::Handle<v8::Object> holder)
+{
+    if (IsWrapped(holder)) return Unwrap(holder);
+
+    // the global object of a context built from the global template
+    return GetGlobal(holder->CreationContext());
+}
+
 bool CPythonObject::IsWrapped(v8::Handle<v8::Object> obj)
 {
     return obj->InternalFieldCount() == 1;
@@ -909,19 +1049,21 @@ v8::Handle<v8::Value> CPythonObject::WrapInternal(py::object obj)
     }
     else if (PyCFunction_Check(obj.ptr()) || PyFunction_Check(obj.ptr()) || PyMethod_Check(obj.ptr()) || PyType_CheckExact(obj.ptr()))
     {
-        v8::Handle<v8::FunctionTemplate> func_tmpl = v8::FunctionTemplate::New(isolate);
         py::object *object = new py::object(obj);
 
-        func_tmpl->SetCallHandler(Caller, v8::External::New(isolate, object));
+        // v8::Function::New doesn't keep the instance in the template cache of the context,
+        // so the function (and the Python callable) can be reclaimed once JS drops it
+        v8::Handle<v8::Function> func = v8::Function::New(isolate->GetCurrentContext(), Caller,
+                                                          v8::External::New(isolate, object)).ToLocalChecked();
 
         if (PyType_Check(obj.ptr()))
         {
             v8::Handle<v8::String> cls_name = v8::String::NewFromUtf8(isolate, py::extract<const char *>(obj.attr("__name__"))()).ToLocalChecked();
 
-            func_tmpl->SetClassName(cls_name);
+            func->SetName(cls_name);
         }
 
-        result = func_tmpl->GetFunction(isolate->GetCurrentContext()).ToLocalChecked();
+        result = func;
 
 #ifdef SUPPORT_TRACE_LIFECYCLE
         if (!result.IsEmpty()) ObjectTracer::Trace(result, object);
@@ -943,7 +1085,7 @@ v8::Handle<v8::Value> CPythonObject::WrapInternal(py::object obj)
             realInstance->SetInternalField(0, v8::External::New(isolate, object));
 
 #ifdef SUPPORT_TRACE_LIFECYCLE
-            ObjectTracer::Trace(instance.ToLocalChecked(), object);
+            ObjectTracer::Trace(instance.ToLocalChecked(), object).ReportExternalSize();
 #endif
 
             result = realInstance;
@@ -956,6 +1098,15 @@ v8::Handle<v8::Value> CPythonObject::WrapInternal(py::object obj)
     return handle_scope.Escape(result);
 }
 
+CJavascriptObject::~CJavascriptObject()
+{
+#ifdef SUPPORT_TRACE_LIFECYCLE
+    if (m_tracer) m_tracer->RemoveWrapper(this);
+#endif
+
+    m_obj.Reset();
+}
+
 void CJavascriptObject::CheckAttr(v8::Handle<v8::String> name) const
 {
     v8::Isolate* isolate = v8::Isolate::GetCurrent();
@@ -1083,7 +1234,7 @@ CJavascriptObjectPtr CJavascriptObject::Clone(void)
     v8::HandleScope handle_scope(v8::Isolate::GetCurrent());
     CHECK_V8_CONTEXT();
 
-    return CJavascriptObjectPtr(new CJavascriptObject(Object()->Clone()));
+    return std::allocate_shared<CJavascriptObject>(CPoolAllocator<CJavascriptObject>(), Object()->Clone());
 }
 
 bool CJavascriptObject::Contains(const std::string& name)
@@ -1261,37 +1412,73 @@ py::object CJavascriptObject::Wrap(v8::Handle<v8::Value> value, v8::Handle<v8::O
 
 py::object CJavascriptObject::Wrap(v8::Handle<v8::Object> obj, v8::Handle<v8::Object> self)
 {
-    v8::HandleScope handle_scope(v8::Isolate::GetCurrent());
+    v8::Isolate *isolate = v8::Isolate::GetCurrent();
+    v8::HandleScope handle_scope(isolate);
 
     if (obj.IsEmpty())
     {
         return py::object();
     }
-    else if (obj->IsArray())
+    else if (CPythonObject::IsWrapped(obj))
     {
-        v8::Handle<v8::Array> array = v8::Handle<v8::Array>::Cast(obj);
+        return CPythonObject::Unwrap(obj);
+    }
 
-        return Wrap(new CJavascriptArray(array));
+#ifdef SUPPORT_TRACE_LIFECYCLE
+    // the identity cache is opt-in, a context without it doesn't need a tracer
+    ContextTracer *tracer = isolate->InContext() ? ContextTracer::Find(isolate->GetCurrentContext()) : NULL;
+
+    if (tracer && !tracer->IsIdentityCacheEnabled()) tracer = NULL;
+
+    if (tracer)
+    {
+        CPythonGIL python_gil;
+
+        PyObject *cached = tracer->FindWrapper(obj, self);
+
+        if (cached) return py::object(py::handle<>(py::borrowed(cached)));
     }
-    else if (CPythonObject::IsWrapped(obj))
+#endif
+
+    CJavascriptObjectPtr wrapper;
+
+    if (obj->IsArray())
     {
-        return CPythonObject::Unwrap(obj);
+        v8::Handle<v8::Array> array = v8::Handle<v8::Array>::Cast(obj);
+
+        wrapper = std::allocate_shared<CJavascriptArray>(CPoolAllocator<CJavascriptArray>(), array);
     }
     else if (obj->IsFunction())
     {
-        return Wrap(new CJavascriptFunction(self, v8::Handle<v8::Function>::Cast(obj)));
+        wrapper = std::allocate_shared<CJavascriptFunction>(CPoolAllocator<CJavascriptFunction>(),
+                  self, v8::Handle<v8::Function>::Cast(obj));
+    }
+    else
+    {
+        wrapper = std::allocate_shared<CJavascriptObject>(CPoolAllocator<CJavascriptObject>(), obj);
     }
 
-    return Wrap(new CJavascriptObject(obj));
+    py::object result = Wrap(wrapper);
+
+#ifdef SUPPORT_TRACE_LIFECYCLE
+    if (tracer && !result.is_none())
+    {
+        CPythonGIL python_gil;
+
+        tracer->AddWrapper(wrapper.get(), result.ptr());
+    }
+#endif
+
+    return result;
 }
 
-py::object CJavascriptObject::Wrap(CJavascriptObject *obj)
+py::object CJavascriptObject::Wrap(CJavascriptObjectPtr obj)
 {
     CPythonGIL python_gil;
 
     TERMINATE_EXECUTION_CHECK(py::object())
 
-    return py::object(py::handle<>(boost::python::converter::shared_ptr_to_python<CJavascriptObject>(CJavascriptObjectPtr(obj))));
+    return py::object(py::handle<>(boost::python::converter::shared_ptr_to_python<CJavascriptObject>(obj)));
 }
 
 void CJavascriptArray::LazyConstructor(void)
@@ -1611,6 +1798,31 @@ py::object CJavascriptFunction::CallWithArgs(py::tuple args, py::dict kwds)
     return func.Call(func.Self(), argv, kwds);
 }
 
+py::object CJavascriptFunction::CallWithTimeout(py::tuple args, py::dict kwds)
+{
+    size_t argc = ::PyTuple_Size(args.ptr());
+
+    if (argc < 2) throw CJavascriptException("missed timeout argument", ::PyExc_TypeError);
+
+    py::object self = args[0];
+    py::extract<CJavascriptFunction&> extractor(self);
+
+    if (!extractor.check()) throw CJavascriptException("missed self argument", ::PyExc_TypeError);
+
+    double timeout = py::extract<double>(args[1]);
+
+    v8::Isolate* isolate = v8::Isolate::GetCurrent();
+    v8::HandleScope handle_scope(isolate);
+    CHECK_V8_CONTEXT();
+
+    CJavascriptFunction& func = extractor();
+    py::list argv(args.slice(2, py::_));
+
+    return CWatchdog::Run(isolate, timeout, [&]() {
+        return func.Call(func.Self(), argv, kwds);
+    });
+}
+
 py::object CJavascriptFunction::Call(v8::Handle<v8::Object> self, py::list args, py::dict kwds)
 {
     v8::Isolate* isolate = v8::Isolate::GetCurrent();
@@ -1640,19 +1852,39 @@ py::object CJavascriptFunction::Call(v8::Handle<v8::Object> self, py::list args,
         params[args_count+i] = CPythonObject::Wrap(values[i]);
     }
 
-    v8::MaybeLocal<v8::Value> result;
+    CContextStats *stats = CContextStats::Get(context);
 
-    Py_BEGIN_ALLOW_THREADS
+    if (stats) stats->calls++;
 
-    result = func->Call(context,
-                        self.IsEmpty() ? isolate->GetCurrentContext()->Global() : self,
-                        params.size(), params.empty() ? NULL : &params[0]);
+    CMessageLoopScope message_loop(isolate);
 
-    Py_END_ALLOW_THREADS
+    return CCpuTimer::Run(context, [&]() {
+        v8::MaybeLocal<v8::Value> result;
 
-    if (result.IsEmpty()) CJavascriptException::ThrowIf(isolate, try_catch);
+        Py_BEGIN_ALLOW_THREADS
 
-    return CJavascriptObject::Wrap(result.ToLocalChecked());
+        {
+            CStatsTimer timer(stats ? &stats->run_time : NULL);
+
+            v8::MicrotasksScope microtasks_scope(isolate, CContextData::GetMicrotaskQueue(context),
+                                                 v8::MicrotasksScope::kRunMicrotasks);
+
+            result = func->Call(context,
+                                self.IsEmpty() ? isolate->GetCurrentContext()->Global() : self,
+                                params.size(), params.empty() ? NULL : &params[0]);
+        }
+
+        Py_END_ALLOW_THREADS
+
+        if (result.IsEmpty())
+        {
+            if (stats && try_catch.HasCaught()) stats->exceptions++;
+
+            CJavascriptException::ThrowIf(isolate, try_catch);
+        }
+
+        return CJavascriptObject::Wrap(result.ToLocalChecked());
+    });
 }
 
 py::object CJavascriptFunction::CreateWithArgs(CJavascriptFunctionPtr proto, py::tuple args, py::dict kwds)
@@ -1837,25 +2069,83 @@ py::object CJavascriptFunction::GetOwner(void) const
 #ifdef SUPPORT_TRACE_LIFECYCLE
 
 ObjectTracer::ObjectTracer(v8::Handle<v8::Value> handle, py::object *object)
-    : m_handle(v8::Isolate::GetCurrent(), handle),
-      m_object(object), m_living(GetLivingMapping())
+    : m_isolate(v8::Isolate::GetCurrent()), m_handle(m_isolate, handle),
+      m_object(object), m_external_size(0),
+      m_context(ContextTracer::Get(m_isolate->GetCurrentContext())), m_prev(NULL), m_next(NULL)
 {
 }
 
 ObjectTracer::~ObjectTracer()
 {
-    if (!m_handle.IsEmpty())
+    Dispose();
+    Forget();
+}
+
+void ObjectTracer::Forget(void)
+{
+    if (m_context)
     {
-        Dispose();
+        CIsolateData::Get(m_isolate)->tracers.Erase(m_object->ptr(), m_context, this);
 
-        m_living->erase(m_object->ptr());
+        m_context->Unlink(this);
+        m_context = NULL;
     }
 }
 
 void ObjectTracer::Dispose(void)
 {
-    // m_handle.ClearWeak();
     m_handle.Reset();
+
+    if (m_external_size)
+    {
+        m_isolate->AdjustAmountOfExternalAllocatedMemory(-m_external_size);
+
+        m_external_size = 0;
+    }
+}
+
+void ObjectTracer::ReportExternalSize(void)
+{
+    CPythonGIL python_gil;
+
+    PyObject *obj = m_object->ptr();
+    PyObject *size = NULL;
+
+    if (::PyObject_HasAttrString(obj, "__v8_external_size__"))
+    {
+        size = ::PyObject_GetAttrString(obj, "__v8_external_size__");
+
+        if (size && ::PyCallable_Check(size))
+        {
+            PyObject *result = ::PyObject_CallObject(size, NULL);
+
+            Py_DECREF(size);
+
+            size = result;
+        }
+    }
+    else
+    {
+        PyObject *getsizeof = ::PySys_GetObject("getsizeof");
+
+        if (getsizeof) size = ::PyObject_CallFunctionObjArgs(getsizeof, obj, NULL);
+    }
+
+    if (size)
+    {
+        m_external_size = ::PyLong_Check(size) ? ::PyLong_AsLongLong(size) : 0;
+
+        Py_DECREF(size);
+    }
+
+    if (::PyErr_Occurred() || m_external_size < 0)
+    {
+        ::PyErr_Clear();
+
+        m_external_size = 0;
+    }
+
+    if (m_external_size) m_isolate->AdjustAmountOfExternalAllocatedMemory(m_external_size);
 }
 
 ObjectTracer& ObjectTracer::Trace(v8::Handle<v8::Value> handle, py::object *object)
@@ -1869,85 +2159,201 @@ ObjectTracer& ObjectTracer::Trace(v8::Handle<v8::Value> handle, py::object *obje
 
 void ObjectTracer::Trace(void)
 {
-    // m_handle.SetWeak(this, WeakCallback, v8::WeakCallbackType::kParameter);
+    m_handle.SetWeak(this, WeakCallback, v8::WeakCallbackType::kParameter);
 
-    m_living->insert(std::make_pair(m_object->ptr(), this));
+    m_context->Link(this);
+
+    CIsolateData::Get(m_isolate)->tracers.Insert(m_object->ptr(), m_context, this);
 }
 
-/*
 void ObjectTracer::WeakCallback(const v8::WeakCallbackInfo<ObjectTracer>& info)
 {
-  std::unique_ptr<ObjectTracer> tracer(info.GetParameter());
+    ObjectTracer *tracer = info.GetParameter();
+
+    // the first pass runs inside the GC, it may only reset the handle;
+    // the Python object is released from the second pass with the GIL held
+    tracer->m_handle.Reset();
+    tracer->Forget();
 
-  // assert(info.GetValue() == tracer->m_handle);
+    info.SetSecondPassCallback(DisposeCallback);
 }
-*/
 
-LivingMap * ObjectTracer::GetLivingMapping(void)
+void ObjectTracer::DisposeCallback(const v8::WeakCallbackInfo<ObjectTracer>& info)
 {
-    v8::HandleScope handle_scope(v8::Isolate::GetCurrent());
+    CPythonGIL python_gil;
+
+    std::unique_ptr<ObjectTracer> tracer(info.GetParameter());
+}
+
+v8::Handle<v8::Value> ObjectTracer::FindCache(py::object obj)
+{
+    v8::Isolate *isolate = v8::Isolate::GetCurrent();
+
+    ContextTracer *context = ContextTracer::Get(isolate->GetCurrentContext());
+
+    ObjectTracer *tracer = CIsolateData::Get(isolate)->tracers.Find(obj.ptr(), context);
+
+    if (tracer) return v8::Local<v8::Value>::New(isolate, tracer->m_handle);
+
+    return v8::Handle<v8::Value>();
+}
+
+ContextTracer::ContextTracer(v8::Handle<v8::Context> ctxt)
+    : m_ctxt(v8::Isolate::GetCurrent(), ctxt), m_living(NULL), m_identity(false)
+{
+}
+
+ContextTracer::~ContextTracer(void)
+{
+    v8::Isolate *isolate = v8::Isolate::GetCurrent();
+    v8::HandleScope handle_scope(isolate);
+
+    v8::Handle<v8::Context> ctxt = Context();
+
+    if (!ctxt.IsEmpty()) ctxt->SetAlignedPointerInEmbedderData(kEmbedderDataIndex, NULL);
 
-    v8::Handle<v8::Context> ctxt = v8::Isolate::GetCurrent()->GetCurrentContext();
+    CPythonGIL python_gil;
+
+    ClearWrappers();
+
+    while (m_living)
+    {
+        std::unique_ptr<ObjectTracer> tracer(m_living);
+
+        tracer->Forget();
+    }
+
+    m_ctxt.Reset();
+}
 
-    v8::Local<v8::String> key = v8::String::NewFromUtf8(v8::Isolate::GetCurrent(), "__living__").ToLocalChecked();
-    v8::Local<v8::Private> privateKey = v8::Private::ForApi(v8::Isolate::GetCurrent(), key);
+void ContextTracer::Link(ObjectTracer *tracer)
+{
+    tracer->m_prev = NULL;
+    tracer->m_next = m_living;
+
+    if (m_living) m_living->m_prev = tracer;
+
+    m_living = tracer;
+}
 
-    v8::MaybeLocal<v8::Value> value = ctxt->Global()->GetPrivate(ctxt, privateKey);
+void ContextTracer::Unlink(ObjectTracer *tracer)
+{
+    if (tracer->m_prev) tracer->m_prev->m_next = tracer->m_next;
+    else if (m_living == tracer) m_living = tracer->m_next;
+
+    if (tracer->m_next) tracer->m_next->m_prev = tracer->m_prev;
+
+    tracer->m_prev = tracer->m_next = NULL;
+}
 
-    if (!value.IsEmpty())
+void ContextTracer::SetIdentityCache(bool enabled)
+{
+    if (!enabled)
     {
-        LivingMap *living = (LivingMap *) v8::External::Cast(*value.ToLocalChecked())->Value();
+        CPythonGIL python_gil;
 
-        if (living) return living;
+        ClearWrappers();
     }
 
-    std::unique_ptr<LivingMap> living(new LivingMap());
+    m_identity = enabled;
+}
+
+void ContextTracer::ClearWrappers(void)
+{
+    WrapperMap wrappers;
 
-    ctxt->Global()->SetPrivate(ctxt, privateKey, v8::External::New(v8::Isolate::GetCurrent(), living.get()));
+    wrappers.swap(m_wrappers);
 
-    ContextTracer::Trace(ctxt, living.get());
+    for (WrapperMap::iterator it = wrappers.begin(); it != wrappers.end(); it++)
+    {
+        it->second.first->m_tracer = NULL;
 
-    return living.release();
+        // dropping the weak reference cancels its callback
+        Py_DECREF(it->second.second);
+    }
 }
 
-v8::Handle<v8::Value> ObjectTracer::FindCache(py::object obj)
+PyObject *ContextTracer::FindWrapper(v8::Handle<v8::Object> obj, v8::Handle<v8::Object> self)
 {
-    LivingMap *living = GetLivingMapping();
+    std::pair<WrapperMap::iterator, WrapperMap::iterator> range = m_wrappers.equal_range(obj->GetIdentityHash());
 
-    if (living)
+    for (WrapperMap::iterator it = range.first; it != range.second; it++)
     {
-        LivingMap::const_iterator it = living->find(obj.ptr());
+        CJavascriptObject *wrapper = it->second.first;
+
+        if (!wrapper->Object()->StrictEquals(obj)) continue;
 
-        if (it != living->end())
+        if (obj->IsFunction())
         {
-            return v8::Local<v8::Value>::New(v8::Isolate::GetCurrent(), it->second->m_handle);
+            // the same function bound to another receiver is another Python object
+            v8::Handle<v8::Object> owner = static_cast<CJavascriptFunction *>(wrapper)->Self();
+
+            if (owner.IsEmpty() != self.IsEmpty()) continue;
+            if (!owner.IsEmpty() && !owner->StrictEquals(self)) continue;
         }
+
+        PyObject *object = PyWeakref_GET_OBJECT(it->second.second);
+
+        if (object != Py_None) return object;
     }
 
-    return v8::Handle<v8::Value>();
+    return NULL;
 }
 
-ContextTracer::ContextTracer(v8::Handle<v8::Context> ctxt, LivingMap *living)
-    : m_ctxt(v8::Isolate::GetCurrent(), ctxt), m_living(living)
+PyObject *ContextTracer::ForgetWrapper(PyObject *capsule, PyObject *UNUSED_VAR(ref))
 {
+    // the Python wrapper is dying, but still holds the C++ object
+    CJavascriptObject *wrapper = static_cast<CJavascriptObject *>(::PyCapsule_GetPointer(capsule, NULL));
+
+    if (wrapper && wrapper->m_tracer) wrapper->m_tracer->RemoveWrapper(wrapper);
+
+    Py_RETURN_NONE;
 }
 
-ContextTracer::~ContextTracer(void)
+void ContextTracer::AddWrapper(CJavascriptObject *wrapper, PyObject *object)
 {
-    v8::HandleScope handle_scope(v8::Isolate::GetCurrent());
+    static PyMethodDef s_forget_wrapper = { "forget_wrapper", ForgetWrapper, METH_O, NULL };
 
-    v8::Handle<v8::Context> ctxt = v8::Isolate::GetCurrent()->GetCurrentContext();
-    v8::Local<v8::String> key = v8::String::NewFromUtf8(v8::Isolate::GetCurrent(), "__living__").ToLocalChecked();
-    v8::Local<v8::Private> privateKey = v8::Private::ForApi(v8::Isolate::GetCurrent(), key);
+    py::object capsule(py::handle<>(::PyCapsule_New(wrapper, NULL, NULL)));
+    py::object callback(py::handle<>(::PyCFunction_New(&s_forget_wrapper, capsule.ptr())));
 
-    Context()->Global()->DeletePrivate(ctxt, privateKey);
+    PyObject *ref = ::PyWeakref_NewRef(object, callback.ptr());
 
-    for (LivingMap::const_iterator it = m_living->begin(); it != m_living->end(); it++)
+    if (!ref)
     {
-        std::unique_ptr<ObjectTracer> tracer(it->second);
+        // not weakly referenceable, so not cached
+        ::PyErr_Clear();
 
-        tracer->Dispose();
+        return;
     }
+
+    wrapper->m_tracer = this;
+    wrapper->m_hash = wrapper->Object()->GetIdentityHash();
+
+    m_wrappers.insert(std::make_pair(wrapper->m_hash, std::make_pair(wrapper, ref)));
+}
+
+void ContextTracer::RemoveWrapper(CJavascriptObject *wrapper)
+{
+    std::pair<WrapperMap::iterator, WrapperMap::iterator> range = m_wrappers.equal_range(wrapper->m_hash);
+
+    for (WrapperMap::iterator it = range.first; it != range.second; it++)
+    {
+        if (it->second.first == wrapper)
+        {
+            PyObject *ref = it->second.second;
+
+            m_wrappers.erase(it);
+
+            CPythonGIL python_gil;
+
+            Py_DECREF(ref);
+
+            break;
+        }
+    }
+
+    wrapper->m_tracer = NULL;
 }
 
 void ContextTracer::WeakCallback(const v8::WeakCallbackInfo<ContextTracer>& info)
@@ -1955,11 +2361,43 @@ void ContextTracer::WeakCallback(const v8::WeakCallbackInfo<ContextTracer>& info
     delete info.GetParameter();
 }
 
-void ContextTracer::Trace(v8::Handle<v8::Context> ctxt, LivingMap *living)
+ContextTracer *ContextTracer::Find(v8::Handle<v8::Context> ctxt)
+{
+    if (ctxt->GetNumberOfEmbedderDataFields() <= kEmbedderDataIndex) return NULL;
+
+    return static_cast<ContextTracer *>(ctxt->GetAlignedPointerFromEmbedderData(kEmbedderDataIndex));
+}
+
+ContextTracer *ContextTracer::Get(v8::Handle<v8::Context> ctxt)
 {
-    ContextTracer *tracer = new ContextTracer(ctxt, living);
+    ContextTracer *found = Find(ctxt);
+
+    if (found) return found;
+
+    std::unique_ptr<ContextTracer> tracer(new ContextTracer(ctxt));
 
     tracer->Trace();
+
+    ctxt->SetAlignedPointerInEmbedderData(kEmbedderDataIndex, tracer.get());
+
+    return tracer.release();
+}
+
+void ContextTracer::Dispose(v8::Handle<v8::Context> ctxt)
+{
+    if (ctxt->GetNumberOfEmbedderDataFields() <= kEmbedderDataIndex) return;
+
+    ContextTracer *tracer = static_cast<ContextTracer *>(ctxt->GetAlignedPointerFromEmbedderData(kEmbedderDataIndex));
+
+    if (!tracer) return;
+
+    CPythonGIL python_gil;
+
+    // JS code may still reach the wrappers, so the Python objects are left
+    // to the weak callbacks, which run as soon as the wrappers are collected
+    while (tracer->m_living) tracer->m_living->Forget();
+
+    delete tracer;
 }
 
 void ContextTracer::Trace(void)
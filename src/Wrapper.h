@@ -4,14 +4,17 @@
 #include <memory>
 #include <iostream>
 #include <map>
+#include <unordered_map>
 #include <sstream>
 
 #include <boost/iterator/iterator_facade.hpp>
 
 #include "Exception.h"
+#include "Pool.h"
 
 class CJavascriptObject;
 class CJavascriptFunction;
+class ContextTracer;
 
 typedef std::shared_ptr<CJavascriptObject> CJavascriptObjectPtr;
 typedef std::shared_ptr<CJavascriptFunction> CJavascriptFunctionPtr;
@@ -53,6 +56,19 @@ public:
 
     static v8::Handle<v8::Value> WrapInternal(py::object obj);
 
+    // the context embedder data slot holding the Python object bound as global
+    static const int kGlobalDataIndex = 2;
+
+    // Template of the global objects resolving the missing globals in the bound Python object, cached per isolate
+    static v8::Handle<v8::ObjectTemplate> GetGlobalTemplate(v8::Isolate *isolate);
+
+    static void BindGlobal(v8::Handle<v8::Context> ctxt, py::object global);
+    static void UnbindGlobal(v8::Handle<v8::Context> ctxt);
+    static py::object GetGlobal(v8::Handle<v8::Context> ctxt);
+
+    // The Python object behind the holder of an interceptor, None for an unbound global
+    static py::object GetHolder(v8::Handle<v8::Object> holder);
+
     static bool IsWrapped(v8::Handle<v8::Object> obj);
     static v8::Handle<v8::Value> Wrap(py::object obj);
     static py::object Unwrap(v8::Handle<v8::Object> obj);
@@ -71,21 +87,32 @@ class CJavascriptObject : public CWrapper
 protected:
     v8::Persistent<v8::Object> m_obj;
 
+#ifdef SUPPORT_TRACE_LIFECYCLE
+    // the context identity cache holding this wrapper, if any
+    ContextTracer *m_tracer;
+    int m_hash;
+
+    friend class ContextTracer;
+#endif
+
     void CheckAttr(v8::Handle<v8::String> name) const;
 
     CJavascriptObject()
+#ifdef SUPPORT_TRACE_LIFECYCLE
+        : m_tracer(NULL), m_hash(0)
+#endif
     {
     }
 public:
     CJavascriptObject(v8::Handle<v8::Object> obj)
         : m_obj(v8::Isolate::GetCurrent(), obj)
+#ifdef SUPPORT_TRACE_LIFECYCLE
+        , m_tracer(NULL), m_hash(0)
+#endif
     {
     }
 
-    virtual ~CJavascriptObject()
-    {
-        m_obj.Reset();
-    }
+    virtual ~CJavascriptObject();
 
     v8::Local<v8::Object> Object(void) const {
         return v8::Local<v8::Object>::New(v8::Isolate::GetCurrent(), m_obj);
@@ -112,7 +139,7 @@ public:
 
     void Dump(std::ostream& os) const;
 
-    static py::object Wrap(CJavascriptObject *obj);
+    static py::object Wrap(CJavascriptObjectPtr obj);
     static py::object Wrap(v8::Handle<v8::Value> value,
                            v8::Handle<v8::Object> self = v8::Handle<v8::Object>());
     static py::object Wrap(v8::Handle<v8::Object> obj,
@@ -219,6 +246,7 @@ public:
     }
 
     static py::object CallWithArgs(py::tuple args, py::dict kwds);
+    static py::object CallWithTimeout(py::tuple args, py::dict kwds);
     static py::object CreateWithArgs(CJavascriptFunctionPtr proto, py::tuple args, py::dict kwds);
 
     py::object ApplyJavascript(CJavascriptObjectPtr self, py::list args, py::dict kwds);
@@ -240,22 +268,28 @@ public:
 
 #ifdef SUPPORT_TRACE_LIFECYCLE
 
-class ObjectTracer;
-
-typedef std::map<PyObject *, ObjectTracer *> LivingMap;
+class ContextTracer;
 
 class ObjectTracer
 {
+    v8::Isolate *m_isolate;
     v8::Persistent<v8::Value> m_handle;
     std::unique_ptr<py::object> m_object;
+    int64_t m_external_size;
 
-    LivingMap *m_living;
+    // the living tracers of a context form an intrusive list
+    ContextTracer *m_context;
+    ObjectTracer *m_prev, *m_next;
 
     void Trace(void);
 
+    // Unlink from the context and drop the cache entry, if it still points to this tracer
+    void Forget(void);
+
     static void WeakCallback(const v8::WeakCallbackInfo<ObjectTracer>& info);
+    static void DisposeCallback(const v8::WeakCallbackInfo<ObjectTracer>& info);
 
-    static LivingMap *GetLivingMapping(void);
+    friend class ContextTracer;
 public:
     ObjectTracer(v8::Handle<v8::Value> handle, py::object *object);
     ~ObjectTracer(void);
@@ -269,6 +303,9 @@ public:
 
     void Dispose(void);
 
+    // Tell V8 how much memory the wrapped Python object retains outside of its heap
+    void ReportExternalSize(void);
+
     static ObjectTracer& Trace(v8::Handle<v8::Value> handle, py::object *object);
 
     static v8::Handle<v8::Value> FindCache(py::object obj);
@@ -277,20 +314,54 @@ public:
 class ContextTracer
 {
     v8::Persistent<v8::Context> m_ctxt;
-    std::unique_ptr<LivingMap> m_living;
+    ObjectTracer *m_living;
+
+    // JS objects to weak references of their Python wrappers, keyed by identity hash;
+    // an entry goes away with its Python wrapper, or with the C++ object if it dies first
+    typedef std::unordered_multimap<int, std::pair<CJavascriptObject *, PyObject *> > WrapperMap;
+
+    bool m_identity;
+    WrapperMap m_wrappers;
+
+    void ClearWrappers(void);
 
     void Trace(void);
 
+    void Link(ObjectTracer *tracer);
+    void Unlink(ObjectTracer *tracer);
+
     static void WeakCallback(const v8::WeakCallbackInfo<ContextTracer>& info);
+
+    static PyObject *ForgetWrapper(PyObject *capsule, PyObject *ref);
+
+    friend class ObjectTracer;
 public:
-    ContextTracer(v8::Handle<v8::Context> ctxt, LivingMap *living);
+    // the context embedder data slot holding the tracer, it also identifies the context in the cache
+    static const int kEmbedderDataIndex = 1;
+
+    ContextTracer(v8::Handle<v8::Context> ctxt);
     ~ContextTracer(void);
 
     v8::Handle<v8::Context> Context(void) const {
         return v8::Local<v8::Context>::New(v8::Isolate::GetCurrent(), m_ctxt);
     }
 
-    static void Trace(v8::Handle<v8::Context> ctxt, LivingMap *living);
+    bool IsIdentityCacheEnabled(void) const {
+        return m_identity;
+    }
+    void SetIdentityCache(bool enabled);
+
+    // Borrowed Python wrapper of the object (and bound self for functions), or NULL
+    PyObject *FindWrapper(v8::Handle<v8::Object> obj, v8::Handle<v8::Object> self);
+    void AddWrapper(CJavascriptObject *wrapper, PyObject *object);
+    void RemoveWrapper(CJavascriptObject *wrapper);
+
+    static ContextTracer *Get(v8::Handle<v8::Context> ctxt);
+    // The tracer of the context, NULL if it has none yet
+    static ContextTracer *Find(v8::Handle<v8::Context> ctxt);
+
+    // Forget the traced objects of the context now, instead of when it is collected
+    static void Dispose(v8::Handle<v8::Context> ctxt);
 };
 
 #endif
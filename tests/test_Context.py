@@ -11,6 +11,147 @@ class TestContext(unittest.TestCase):
             self.assertEqual(2, context.eval("1+1"))
             self.assertEqual('Hello world', context.eval("'Hello ' + 'world'"))
 
+    def testTimeout(self):
+        with STPyV8.JSContext() as ctxt:
+            self.assertTrue(issubclass(STPyV8.JSTimeoutError, TimeoutError))
+            self.assertRaises(STPyV8.JSTimeoutError, ctxt.eval, "while (true) {}", timeout = 0.1)
+            self.assertEqual(2, ctxt.eval("1+1", timeout = 10))
+
+            loop = ctxt.eval("(function (n) { while (n) {} return n; })")
+
+            self.assertRaises(STPyV8.JSTimeoutError, loop.callWithTimeout, 0.1, 1)
+            self.assertEqual(0, loop.callWithTimeout(10, 0))
+
+            echo = ctxt.eval("(function (value) { return value; })")
+
+            self.assertEqual(5, echo(timeout = 5))
+            self.assertEqual(5, echo.callWithTimeout(10, timeout = 5))
+
+            with STPyV8.JSEngine() as engine:
+                script = engine.compile("for (;;) {}")
+
+                self.assertRaises(STPyV8.JSTimeoutError, script.run, timeout = 0.1)
+
+            self.assertEqual(2, ctxt.eval("1+1"))
+
+    def testCpuBudget(self):
+        with STPyV8.JSContext() as ctxt:
+            ctxt.eval("for (var i = 0; i < 1000000; i++) {}")
+            ctxt.eval("for (var i = 0; i < 1000000; i++) {}")
+
+            self.assertEqual(0, ctxt.cpuTime)
+
+        with STPyV8.JSContext() as ctxt:
+            self.assertEqual(0, ctxt.cpuBudget)
+
+            ctxt.eval("for (var i = 0; i < 1000000; i++) {}")
+
+            used = ctxt.cpuTime
+
+            self.assertTrue(used > 0)
+            self.assertRaises(ValueError, setattr, ctxt, 'cpuBudget', -1)
+
+            ctxt.cpuBudget = used + 0.05
+
+            self.assertRaises(STPyV8.JSTimeoutError, ctxt.eval, "while (true) {}")
+            self.assertTrue(ctxt.cpuTime >= used + 0.05)
+            self.assertRaises(STPyV8.JSTimeoutError, ctxt.eval, "1+1")
+
+            ctxt.cpuBudget = 0
+
+            self.assertEqual(2, ctxt.eval("1+1"))
+
+    def testStats(self):
+        class Global(STPyV8.JSClass):
+            def hello(self):
+                return "hello"
+
+        with STPyV8.JSContext(Global()) as ctxt:
+            ctxt.eval("1+1")
+
+            self.assertFalse(ctxt.statsEnabled)
+            self.assertEqual(0, ctxt.stats()['evals'])
+
+            ctxt.statsEnabled = True
+
+            ctxt.eval("hello()")
+            ctxt.eval("function add(a, b) { return a + b; }")
+
+            self.assertRaises(SyntaxError, ctxt.eval, "1 +")
+            self.assertRaises(STPyV8.JSError, ctxt.eval, "throw new Error()")
+
+            self.assertEqual(3, ctxt.locals.add(1, 2))
+
+            stats = ctxt.stats()
+
+            self.assertEqual(3, stats['evals'])
+            self.assertEqual(1, stats['calls'])
+            self.assertTrue(stats['callbacks'] >= 2)
+            self.assertEqual(2, stats['exceptions'])
+            self.assertTrue(stats['runTime'] > 0)
+            self.assertTrue(stats['compileTime'] > 0)
+            self.assertTrue(stats['callbackTime'] > 0)
+
+            ctxt.resetStats()
+
+            self.assertEqual(0, ctxt.stats()['evals'])
+
+            ctxt.statsEnabled = False
+
+            ctxt.eval("1+1")
+
+            self.assertEqual(0, ctxt.stats()['evals'])
+
+    def testEvalCached(self):
+        class Global(STPyV8.JSClass):
+            calls = 0
+
+            def rule(self, value):
+                self.calls += 1
+                return value * 2
+
+        g = Global()
+
+        with STPyV8.JSContext(g) as ctxt:
+            self.assertEqual(42, ctxt.evalCached("rule(x) + y", {'x': 20, 'y': 2}))
+            self.assertEqual(42, ctxt.evalCached("rule(x) + y", {'y': 2, 'x': 20}))
+            self.assertEqual(1, g.calls)
+
+            # 1, 1.0 and True are different inputs
+            self.assertEqual("number", ctxt.evalCached("typeof x", {'x': 1}))
+            self.assertEqual("boolean", ctxt.evalCached("typeof x", {'x': True}))
+            self.assertEqual("string", ctxt.evalCached("typeof x", {'x': "1"}))
+            self.assertEqual("object", ctxt.evalCached("typeof x", {'x': None}))
+
+            self.assertEqual(2, ctxt.evalCached("var a = 1; a + 1"))
+            self.assertRaises(STPyV8.JSError, ctxt.eval, "a")
+
+            self.assertRaises(TypeError, ctxt.evalCached, "x", {'x': []})
+            self.assertRaises(ValueError, ctxt.evalCached, "x", {'not a name': 1})
+
+            for name in ['class', 'new', 'this', 'function', 'var', 'let', 'static', 'arguments', 'eval']:
+                self.assertRaises(ValueError, ctxt.evalCached, "1", {name: 1})
+
+            # the compiled wrapper is shared by the sources with the same inputs
+            self.assertEqual(3, ctxt.evalCached("x + 1", {'x': 2}))
+            self.assertEqual(4, ctxt.evalCached("x * 2", {'x': 2}))
+
+            ctxt.invalidateCached("rule(x) + y")
+            ctxt.evalCached("rule(x) + y", {'x': 20, 'y': 2})
+
+            self.assertEqual(2, g.calls)
+
+            ctxt.evalCacheSize = 1
+            ctxt.evalCached("rule(1)")
+            ctxt.evalCached("rule(x) + y", {'x': 20, 'y': 2})
+
+            self.assertEqual(4, g.calls)
+
+            ctxt.invalidateCached()
+            ctxt.evalCached("rule(x) + y", {'x': 20, 'y': 2})
+
+            self.assertEqual(5, g.calls)
+
     def testMultiNamespace(self):
         self.assertTrue(not bool(STPyV8.JSContext.inContext))
         self.assertTrue(not bool(STPyV8.JSContext.entered))
@@ -93,6 +234,204 @@ class TestContext(unittest.TestCase):
             # with env2:
             #    self.assertRaises(STPyV8.JSError, spy2.apply, env2.locals)
 
+    def testDispose(self):
+        class Global(STPyV8.JSClass):
+            name = "global"
+
+        g = Global()
+        g_refs = sys.getrefcount(g)
+
+        ctxt = STPyV8.JSContext(g)
+
+        with ctxt:
+            self.assertEqual("global", ctxt.eval("name"))
+            self.assertRaises(RuntimeError, ctxt.dispose)
+
+            # entered, but not the current context
+            with STPyV8.JSContext():
+                self.assertRaises(RuntimeError, ctxt.dispose)
+
+        ctxt.dispose()
+
+        self.assertFalse(ctxt)
+        self.assertIsNone(ctxt.locals)
+        self.assertRaises(RuntimeError, ctxt.enter)
+
+        ctxt.dispose()
+
+        STPyV8.JSEngine.lowMemory()
+
+        self.assertEqual(g_refs, sys.getrefcount(g))
+
+    def testGlobalTemplate(self):
+        class Global(STPyV8.JSClass):
+            name = "global"
+            Math = "shadowed"
+
+        g = Global()
+
+        with STPyV8.JSContext(g) as ctxt:
+            self.assertEqual("global", ctxt.eval("name"))
+            self.assertEqual("global", ctxt.locals.name)
+            self.assertTrue(ctxt.eval("Object.getPrototypeOf(this) === Object.prototype"))
+            self.assertEqual(3, ctxt.eval("Math.max(1, 3)"))
+            self.assertEqual("undefined", ctxt.eval("typeof missing"))
+
+            ctxt.eval("var local = 1; created = 2; name = 'changed';")
+
+            # the assignments stay in Javascript, as with the Python object as prototype
+            self.assertFalse(hasattr(g, 'local'))
+            self.assertFalse(hasattr(g, 'created'))
+            self.assertEqual(2, ctxt.eval("created"))
+            self.assertEqual("changed", ctxt.eval("name"))
+            self.assertEqual("global", g.name)
+
+        with STPyV8.JSContext(Global()) as other:
+            self.assertEqual("undefined", other.eval("typeof created"))
+
+    def testContextScope(self):
+        ctxt = STPyV8.JSContext()
+
+        self.assertFalse(STPyV8.JSContext.inContext)
+
+        # locking would turn the Locker on for the whole process
+        scope = STPyV8.JSContextScope(ctxt, lock = False)
+
+        with scope as entered:
+            self.assertTrue(scope)
+            self.assertTrue(STPyV8.JSContext.inContext)
+            self.assertEqual(2, entered.eval("1+1"))
+
+            self.assertRaises(RuntimeError, scope.enter)
+
+        self.assertFalse(scope)
+        self.assertFalse(STPyV8.JSContext.inContext)
+
+        with scope:
+            self.assertEqual(3, ctxt.eval("1+2"))
+
+    def testContextPool(self):
+        class Global(STPyV8.JSClass):
+            name = "global"
+
+        pool = STPyV8.JSContextPool(1)
+
+        self.assertEqual(1, pool.size)
+        self.assertEqual(1, pool.idle)
+
+        with pool.context(Global()) as ctxt:
+            self.assertEqual(0, pool.idle)
+            self.assertEqual(1, pool.busy)
+            self.assertEqual("global", ctxt.eval("name"))
+
+            ctxt.eval("var leaked = 1; Math = null; delete JSON; this.extra = {};")
+
+        self.assertEqual(1, pool.idle)
+        self.assertEqual(0, pool.busy)
+        self.assertRaises(RuntimeError, ctxt.enter)
+        self.assertRaises(ValueError, pool.release, ctxt)
+
+        with pool.context() as ctxt:
+            self.assertEqual("undefined", ctxt.eval("typeof name"))
+            self.assertEqual("undefined", ctxt.eval("typeof leaked"))
+            self.assertEqual("undefined", ctxt.eval("typeof extra"))
+            self.assertEqual(3, ctxt.eval("Math.max(1, 3)"))
+            self.assertEqual("[]", ctxt.eval("JSON.stringify([])"))
+
+            self.assertRaises(RuntimeError, pool.release, ctxt)
+
+        # the lexical bindings can't be reset, the context is replaced
+        with pool.context() as ctxt:
+            ctxt.eval("let declared = 1; class Declared {}")
+
+        self.assertEqual(1, pool.idle)
+
+        with pool.context() as ctxt:
+            self.assertEqual(2, ctxt.eval("let declared = 2; declared"))
+
+        calls = []
+
+        class Hooked(STPyV8.JSClass):
+            def hit(self):
+                calls.append(True)
+
+        with pool.context(Hooked()) as ctxt:
+            ctxt.eval("var h = hit; Object.defineProperty(this, '__proto__', { set: function (v) { h(); }, configurable: true });")
+
+        self.assertEqual([], calls)
+
+        with pool.context() as ctxt:
+            self.assertEqual("function", ctxt.eval("typeof hasOwnProperty"))
+
+        with STPyV8.JSContext() as other:
+            self.assertRaises(ValueError, pool.release, other)
+            self.assertRaises(RuntimeError, STPyV8.JSContext.current.dispose)
+
+        ctxt = pool.acquire()
+
+        self.assertRaises(RuntimeError, ctxt.dispose)
+
+        pool.release(ctxt)
+
+        self.assertEqual(1, pool.idle)
+        self.assertEqual(0, pool.busy)
+
+    def testIdentityCache(self):
+        with STPyV8.JSContext() as ctxt:
+            ctxt.eval("var o = {}; var a = [1, 2]; var f = function () {};")
+
+            self.assertFalse(ctxt.identityCache)
+            self.assertIsNot(ctxt.locals.o, ctxt.locals.o)
+
+            ctxt.identityCache = True
+
+            self.assertTrue(ctxt.identityCache)
+            self.assertIs(ctxt.locals.o, ctxt.locals.o)
+            self.assertIs(ctxt.locals.a, ctxt.locals.a)
+            self.assertIs(ctxt.locals.f, ctxt.locals.f)
+            self.assertIs(ctxt.locals.o, ctxt.eval("o"))
+
+            objs = {ctxt.locals.o: "o"}
+
+            self.assertEqual("o", objs[ctxt.eval("o")])
+
+            del objs
+
+            self.assertEqual(2, len(ctxt.locals.a))
+
+            o = ctxt.locals.o
+            del o
+
+            self.assertIs(ctxt.locals.o, ctxt.locals.o)
+
+            ctxt.identityCache = False
+
+            self.assertIsNot(ctxt.locals.o, ctxt.locals.o)
+
+            local = ctxt.locals
+
+        # no context is entered to look the identity cache up in
+        self.assertEqual(2, len(local.a))
+
+    def testMeasureMemory(self):
+        with STPyV8.JSContext() as ctxt:
+            small = ctxt.measureMemory()
+
+            self.assertTrue(small > 0)
+
+            ctxt.eval("var data = []; for (var i = 0; i < 100000; i++) data.push({value: i});")
+
+            self.assertTrue(ctxt.measureMemory(STPyV8.JSContext.MeasureMemoryExecution.Eager) > small)
+
+            self.assertRaises(ValueError, ctxt.measureMemory, STPyV8.JSContext.MeasureMemoryExecution.Lazy)
+
+            sizes = []
+
+            ctxt.measureMemory(STPyV8.JSContext.MeasureMemoryExecution.Lazy, sizes.append)
+            ctxt.measureMemory(STPyV8.JSContext.MeasureMemoryExecution.Eager)
+
+            self.assertEqual(1, len(sizes))
+
 
 if __name__ == '__main__':
     level = logging.DEBUG if "-v" in sys.argv else logging.WARN
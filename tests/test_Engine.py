@@ -191,6 +191,83 @@ class TestEngine(unittest.TestCase):
 
         self.assertTrue(newStackSize > oldStackSize * 2)
 
+    def testMemoryPressureWatcher(self):
+        import time
+        import tempfile
+
+        Level = STPyV8.JSEngine.MemoryPressureLevel
+
+        def wait_for(level):
+            for _ in range(200):
+                if STPyV8.JSEngine.memoryPressure == level:
+                    break
+
+                time.sleep(0.01)
+
+            return STPyV8.JSEngine.memoryPressure
+
+        def write(path, name, value):
+            with open(os.path.join(path, name), "w") as fd:
+                fd.write(value)
+
+        self.assertEqual(Level.Normal, STPyV8.JSEngine.memoryPressure)
+        self.assertFalse(STPyV8.JSEngine.watchMemoryPressure("/nonexistent"))
+
+        with tempfile.TemporaryDirectory() as path:
+            write(path, "memory.current", "100\n")
+            write(path, "memory.max", "1000\n")
+
+            self.assertTrue(STPyV8.JSEngine.watchMemoryPressure(path, interval = 10))
+            self.assertEqual(Level.Normal, wait_for(Level.Normal))
+
+            write(path, "memory.current", "900\n")
+            self.assertEqual(Level.Moderate, wait_for(Level.Moderate))
+
+            write(path, "memory.current", "990\n")
+            self.assertEqual(Level.Critical, wait_for(Level.Critical))
+
+            with STPyV8.JSContext() as ctxt:
+                self.assertEqual(2, ctxt.eval("1+1"))
+
+            STPyV8.JSEngine.unwatchMemoryPressure()
+
+        self.assertEqual(Level.Normal, STPyV8.JSEngine.memoryPressure)
+
+    def testPageAllocator(self):
+        import subprocess
+
+        self.assertEqual(0, STPyV8.JSPlatform.reservedBytes)
+
+        script = """
+import STPyV8
+with STPyV8.JSContext() as ctxt:
+    ctxt.eval("var a = []; for (var i = 0; i < 100000; i++) a.push({ i: i });")
+print(STPyV8.JSPlatform.hugePages, STPyV8.JSPlatform.reservedBytes, STPyV8.JSPlatform.committedBytes)
+"""
+        env = dict(os.environ, STPYV8_HUGE_PAGES = "1", STPYV8_PREFAULT = str(4 * 1024 * 1024))
+
+        output = subprocess.check_output([sys.executable, "-c", script], env = env)
+
+        huge_pages, reserved, committed = output.split()
+
+        self.assertEqual(b"True", huge_pages)
+        self.assertTrue(int(reserved) >= int(committed) > 0)
+
+    def testWrapperStats(self):
+        with STPyV8.JSContext() as ctxt:
+            ctxt.eval("var objs = []; for (var i = 0; i < 100; i++) objs.push({});")
+
+            before = STPyV8.JSEngine.wrapperStats
+
+            for i in range(100):
+                ctxt.eval("objs[%d]" % i)
+
+            after = STPyV8.JSEngine.wrapperStats
+
+            self.assertTrue(after['allocated'] >= before['allocated'] + 100)
+            self.assertTrue(after['freed'] >= before['freed'] + 99)
+            self.assertTrue(after['reused'] >= before['reused'] + 99)
+
 
 if __name__ == '__main__':
     level = logging.DEBUG if "-v" in sys.argv else logging.WARN
@@ -1,3 +1,4 @@
+import os
 import sys
 import unittest
 import logging
@@ -15,6 +16,224 @@ class TestIsolate(unittest.TestCase):
         with STPyV8.JSIsolate() as isolate:
             self.assertIsNotNone(isolate.current)
 
+    def testArrayBufferLimit(self):
+        with STPyV8.JSIsolate() as isolate:
+            with STPyV8.JSContext() as ctxt:
+                self.assertEqual(0, isolate.arrayBufferLimit)
+
+                ctxt.eval("var buf = new ArrayBuffer(1024 * 1024);")
+
+                self.assertTrue(isolate.arrayBufferLive >= 1024 * 1024)
+                self.assertTrue(isolate.arrayBufferPeak >= isolate.arrayBufferLive)
+                self.assertTrue(isolate.arrayBufferTotal >= isolate.arrayBufferLive)
+
+                isolate.arrayBufferLimit = isolate.arrayBufferLive + 1024
+
+                self.assertRaises(IndexError, ctxt.eval, "new ArrayBuffer(1024 * 1024)")
+
+                ctxt.eval("new ArrayBuffer(512)")
+
+                isolate.arrayBufferLimit = 0
+
+    def testIdle(self):
+        with STPyV8.JSIsolate() as isolate:
+            with STPyV8.JSContext() as ctxt:
+                ctxt.eval("var garbage = []; for (var i = 0; i < 1000000; i++) garbage.push({ index: i }); garbage = null;")
+
+                before = isolate.usedHeapSize
+
+                for _ in range(100):
+                    if isolate.idle(50):
+                        break
+
+                self.assertTrue(isolate.usedHeapSize < before)
+
+            self.assertEqual(0, isolate.idleTime)
+
+            isolate.idleTime = 5
+
+            with STPyV8.JSContext() as ctxt:
+                self.assertEqual(2, ctxt.eval("1+1"))
+
+            isolate.idleTime = 0
+
+    def testDispose(self):
+        isolate = STPyV8.JSIsolate()
+
+        with isolate:
+            with STPyV8.JSContext() as ctxt:
+                self.assertEqual(2, ctxt.eval("1+1"))
+
+            del ctxt
+
+            self.assertRaises(RuntimeError, isolate.dispose)
+
+            current = STPyV8.JSIsolate.current
+
+        self.assertRaises(RuntimeError, current.dispose)
+
+        isolate.dispose()
+        isolate.dispose()
+
+        self.assertRaises(RuntimeError, isolate.enter)
+
+    def testWriteHeapSnapshot(self):
+        import json
+        import tempfile
+
+        with STPyV8.JSIsolate() as isolate:
+            with STPyV8.JSContext() as ctxt:
+                ctxt.eval("var retained = []; for (var i = 0; i < 1000; i++) retained.push({ index: i });")
+
+                with tempfile.TemporaryDirectory() as path:
+                    filename = os.path.join(path, "isolate.heapsnapshot")
+
+                    isolate.writeHeapSnapshot(filename)
+
+                    with open(filename) as f:
+                        snapshot = json.load(f)
+
+                    self.assertTrue('snapshot' in snapshot)
+                    self.assertTrue(snapshot['snapshot']['node_count'] > 1000)
+
+                    self.assertRaises(OSError, isolate.writeHeapSnapshot, os.path.join(path, "missing", "file"))
+
+    def testHeapTuning(self):
+        with STPyV8.JSIsolate() as isolate:
+            self.assertEqual([], isolate.heapTuningLog)
+            self.assertRaises(ValueError, isolate.startHeapTuning, 64 * 1024 * 1024, 16 * 1024 * 1024)
+
+            isolate.startHeapTuning(16 * 1024 * 1024, 512 * 1024 * 1024)
+
+            with STPyV8.JSContext() as ctxt:
+                ctxt.eval("""
+                    var retained = [];
+                    for (var i = 0; i < 64; i++) retained.push(new Array(128 * 1024).fill(i));
+                """)
+
+            log = isolate.heapTuningLog
+
+            self.assertEqual('start', log[0][1])
+            self.assertTrue(all(len(decision) == 5 for decision in log))
+
+            grown = [decision for decision in log if decision[1] == 'grow']
+
+            self.assertTrue(grown)
+            self.assertTrue(all(decision[2] < decision[3] <= 512 * 1024 * 1024 for decision in grown))
+
+            isolate.stopHeapTuning()
+
+            self.assertEqual([], isolate.heapTuningLog)
+
+    def testAllocationSampling(self):
+        def walk(node):
+            yield node
+
+            for child in node[5]:
+                yield from walk(child)
+
+        with STPyV8.JSIsolate() as isolate:
+            with STPyV8.JSContext() as ctxt:
+                self.assertIsNone(isolate.stopAllocationSampling())
+                self.assertTrue(isolate.startAllocationSampling(1024))
+                self.assertFalse(isolate.startAllocationSampling())
+
+                ctxt.eval("""
+                    var retained = [];
+                    function allocate() {
+                        for (var i = 0; i < 10000; i++) retained.push({ index: i, name: 'item' + i });
+                    }
+                    allocate();
+                """, "alloc.js")
+
+                root = isolate.stopAllocationSampling()
+
+                self.assertEqual(6, len(root))
+
+                nodes = [node for node in walk(root) if node[0] == 'allocate']
+
+                self.assertTrue(nodes)
+                self.assertEqual('alloc.js', nodes[0][1])
+                self.assertTrue(sum(node[4] for node in nodes) > 0)
+
+                self.assertIsNone(isolate.stopAllocationSampling())
+
+    def testMicrotasksPolicy(self):
+        with STPyV8.JSIsolate() as isolate:
+            self.assertEqual(STPyV8.JSIsolate.MicrotasksPolicy.Auto, isolate.microtasksPolicy)
+
+            isolate.microtasksPolicy = STPyV8.JSIsolate.MicrotasksPolicy.Explicit
+
+            with STPyV8.JSContext() as ctxt:
+                ctxt.eval("var done = 0; for (var i = 0; i < 10; i++) Promise.resolve().then(() => done++);")
+
+                self.assertEqual(0, ctxt.eval("done"))
+
+                ctxt.runMicrotasks()
+
+                self.assertEqual(10, ctxt.eval("done"))
+
+            isolate.microtasksPolicy = STPyV8.JSIsolate.MicrotasksPolicy.Scoped
+
+            with STPyV8.JSContext() as ctxt:
+                ctxt.eval("var done = false; Promise.resolve().then(() => done = true);")
+
+                self.assertTrue(ctxt.eval("done"))
+
+            isolate.microtasksPolicy = STPyV8.JSIsolate.MicrotasksPolicy.Auto
+
+    def testMicrotaskQueue(self):
+        with STPyV8.JSIsolate() as isolate:
+            isolate.microtasksPolicy = STPyV8.JSIsolate.MicrotasksPolicy.Explicit
+
+            first = STPyV8.JSContext(microtask_queue = True)
+            second = STPyV8.JSContext(microtask_queue = True)
+
+            self.assertTrue(first.hasMicrotaskQueue)
+            self.assertFalse(STPyV8.JSContext().hasMicrotaskQueue)
+
+            for ctxt in (first, second):
+                with ctxt:
+                    ctxt.eval("var done = 0; for (var i = 0; i < 10; i++) Promise.resolve().then(() => done++);")
+
+            with first:
+                first.runMicrotasks()
+
+                self.assertEqual(10, first.eval("done"))
+
+            with second:
+                self.assertEqual(0, second.eval("done"))
+
+                second.runMicrotasks()
+
+                self.assertEqual(10, second.eval("done"))
+
+            isolate.microtasksPolicy = STPyV8.JSIsolate.MicrotasksPolicy.Auto
+
+    def testGCStats(self):
+        events = []
+
+        with STPyV8.JSIsolate() as isolate:
+            isolate.gcCallback = lambda *args: events.append(args)
+
+            with STPyV8.JSContext() as ctxt:
+                # no forced GC, the events of the allocation driven ones are drained once the eval returns
+                ctxt.eval("var garbage = []; for (var i = 0; i < 100000; i++) garbage.push({}); garbage = null;")
+                ctxt.eval("(function () { for (var i = 0; i < 256; i++) new Array(65536).fill(i); })()")
+
+            stats = isolate.gcStats()
+
+            self.assertTrue(stats['pauses']['markSweepCompact']['count'] > 0)
+            self.assertEqual(stats['pauses']['markSweepCompact']['count'],
+                             sum(stats['pauses']['markSweepCompact']['histogram']))
+            self.assertTrue(stats['heapBefore'] > 0)
+
+            self.assertTrue(events)
+            self.assertTrue(all(len(event) == 4 for event in events))
+            self.assertTrue('markSweepCompact' in [event[0] for event in events])
+
+            isolate.gcCallback = None
+
 if __name__ == '__main__':
     level = logging.DEBUG if "-v" in sys.argv else logging.WARN
     logging.basicConfig(level = level, format = '%(asctime)s %(levelname)s %(message)s')
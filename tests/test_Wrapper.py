@@ -5,12 +5,17 @@ import sys
 import os
 import unittest
 import logging
+import weakref
 
 import datetime
 
 import STPyV8
 
 
+# enough JavaScript garbage for the allocation driven GCs, full ones included, to run
+CHURN = "(function () { for (var i = 0; i < 256; i++) new Array(65536).fill(i); })()"
+
+
 def convert(obj):
     if isinstance(obj, STPyV8.JSArray):
         return [convert(v) for v in obj]
@@ -734,6 +739,9 @@ class TestWrapper(unittest.TestCase):
 
             del ctxt
 
+        with STPyV8.JSContext() as ctxt:
+            ctxt.eval(CHURN)
+
         self.assertEqual(g_refs, sys.getrefcount(g))
 
     def testProperty(self):
@@ -828,6 +836,81 @@ class TestWrapper(unittest.TestCase):
             self.assertTrue(ctxt.eval("b == b"))
             self.assertTrue(ctxt.eval("o == o"))
 
+            objs = [object() for i in range(1000)]
+
+            ctxt.locals.objs = objs
+
+            self.assertTrue(ctxt.eval("""
+                (function () {
+                    for (var i = 0; i < 1000; i++) {
+                        if (objs[i] !== objs[i]) return false;
+                    }
+                    return true;
+                })()
+            """))
+
+            with STPyV8.JSContext() as other:
+                other.locals.o = Global.o
+
+                self.assertTrue(other.eval("o === o"))
+                self.assertTrue(ctxt.eval("o === o"))
+
+    def testExternalSize(self):
+        class Blob(object):
+            def __init__(self, size):
+                self.size = size
+
+            def __v8_external_size__(self):
+                return self.size
+
+        with STPyV8.JSIsolate() as isolate:
+            with STPyV8.JSContext() as ctxt:
+                before = isolate.externalMemory
+
+                ctxt.locals.blob = Blob(64 * 1024 * 1024)
+
+                self.assertTrue(isolate.externalMemory >= before + 64 * 1024 * 1024)
+
+                ctxt.locals.data = bytearray(1024 * 1024)
+
+                self.assertTrue(isolate.externalMemory >= before + 65 * 1024 * 1024)
+
+    @unittest.skipUnless(os.path.exists("/proc/self/statm"), "requires procfs")
+    def testWrapperReclaimed(self):
+        class Payload(object):
+            def __init__(self):
+                self.data = bytearray(256 * 1024)
+
+            def size(self):
+                return len(self.data)
+
+        def rss():
+            with open("/proc/self/statm") as f:
+                return int(f.read().split()[1]) * os.sysconf("SC_PAGE_SIZE")
+
+        with STPyV8.JSContext() as ctxt:
+            # every call leaves a large array behind, the GCs are only driven by allocations
+            fn = ctxt.eval("(function (obj) { garbage = new Array(32768).fill(0); return obj.size(); })")
+
+            payload = Payload()
+            ref = weakref.ref(payload)
+
+            self.assertEqual(256 * 1024, fn(payload))
+
+            del payload
+
+            ctxt.eval(CHURN)
+
+            self.assertIsNone(ref())
+
+            baseline = rss()
+
+            # 1000 leaked payloads would retain ~256MB
+            for i in range(1000):
+                fn(Payload())
+
+            self.assertTrue(rss() - baseline < 64 * 1024 * 1024)
+
     def testNamedSetter(self):
         class Obj(STPyV8.JSClass):
             @property